@@ -9,6 +9,10 @@
 #include "cqp.h"
 #include "appmain.h" //ӦAppIDϢȷдQ޷
 #include "../dispose.h"
+#include "../util/result_cache.h"
+#include "../util/config.h"
+#include "../util/prime.h"
+#include "../util/thread_pool.h"
 
 
 using namespace std;
@@ -40,7 +44,12 @@ CQEVENT(int32_t, Initialize, 4)(int32_t AuthCode) {
 * ǱҪشڡӲ˵ûֶ򿪴ڣ
 */
 CQEVENT(int32_t, __eventStartup, 0)() {
-
+	//ֻ¼ļ·ļڵһμʱӳ
+	util_cache::Init(std::string(CQ_getAppDirectory(ac)) + "result.cache");
+	//ļ޸ĺɼ߳Զ¼أҪQ
+	util_config::Init(std::string(CQ_getAppDirectory(ac)) + "config.ini");
+	//ֽʹõɸֻһ
+	util_prime::Init();
 	return 0;
 }
 
@@ -51,7 +60,12 @@ CQEVENT(int32_t, __eventStartup, 0)() {
 * Ϻ󣬿Qܿرգ벻Ҫ̵ͨ߳ȷʽִ롣
 */
 CQEVENT(int32_t, __eventExit, 0)() {
-
+	util_cache::Close();
+	//̶̨߳DLLжǰգ̬
+	//ֹͣļļ߳
+	util_config::Shutdown();
+	//̳߳صĹ߳
+	util_pool::Shutdown();
 	return 0;
 }
 
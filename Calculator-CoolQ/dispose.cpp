@@ -1,7 +1,18 @@
 #include "dispose.h"
 #include "util/rpn.h"
 #include "util/kmp.h"
+#include "util/result_cache.h"
+#include "util/config.h"
+#include "util/prime.h"
+#include "util/integrate.h"
+#include "util/solve.h"
 #include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stack>
 
 std::string ToBit(uint64_t number, int bit)
@@ -45,51 +56,458 @@ void RemoveExcessZero(std::string& str)
 }
 
 
+/**
+** תΪظݣλô1ʼ
+** @param error 
+** @return ظ
+*/
+std::string CalcErrorMessage(const CalcError& error)
+{
+	const char* reason = "ʽ";
+	switch (error.code)
+	{
+	case CalcErrc::kMissingOperand:
+		reason = "ȱٲ";
+		break;
+	case CalcErrc::kMissingOperator:
+		reason = "ȱ";
+		break;
+	case CalcErrc::kUnbalancedParenthesis:
+		reason = "Ųƥ";
+		break;
+	case CalcErrc::kUnknownToken:
+		reason = "޷ʶķ";
+		break;
+	case CalcErrc::kInvalidNumber:
+		reason = "ָʽ";
+		break;
+	case CalcErrc::kWrongArgumentCount:
+		reason = "";
+		break;
+	case CalcErrc::kDivideByZero:
+		reason = "Ϊ0";
+		break;
+	case CalcErrc::kDomainError:
+		reason = "";
+		break;
+	case CalcErrc::kNoModularInverse:
+		reason = "ģԪ";
+		break;
+	case CalcErrc::kOverflow:
+		reason = "ɱʾķΧ";
+		break;
+	case CalcErrc::kBudgetExceeded:
+		reason = "";
+		break;
+	case CalcErrc::kInvalidDigit:
+		reason = "λƷΧ";
+		break;
+	case CalcErrc::kDimensionMismatch:
+		reason = "λٲһ";
+		break;
+	case CalcErrc::kAffineUnit:
+		reason = "¶ȵλֻдڱʽĩβֵ֮";
+		break;
+	default:
+		break;
+	}
+
+	return std::string("ʽ󣺵") + std::to_string(error.position + 1) + "ַ" + reason;
+}
+
+/**
+** ֽΪһ64λķǸ
+** @param arg 
+** @param result ظ
+*/
+void DisposeFactor(const std::string& arg, std::string& result)
+{
+	const char* begin = arg.c_str();
+	while (*begin == ' ') ++begin;
+
+	const char* end = begin;
+	while (*end >= '0' && *end <= '9') ++end;
+
+	const char* rest = end;
+	while (*rest == ' ') ++rest;
+
+	errno = 0;
+	uint64_t n = strtoull(begin, nullptr, 10);
+	if (begin == end || *rest != 0 || errno == ERANGE)
+	{
+		result = "һ64λķǸ";
+		return;
+	}
+
+	std::string number(begin, end);
+	if (n < 2)
+	{
+		result = number + " ȲҲǺ";
+		return;
+	}
+
+	if (util_prime::IsPrime(n))
+	{
+		result = number + " ";
+		return;
+	}
+
+	std::vector<std::pair<uint64_t, int>> factors;
+	bool complete = util_prime::Factor(n, factors);
+
+	result = number + " =";
+	for (size_t i = 0; i < factors.size(); ++i)
+	{
+		if (i != 0) result += " *";
+		result += " " + std::to_string(factors[i].first);
+		if (factors[i].second > 1) result += "^" + std::to_string(factors[i].second);
+	}
+
+	if (!complete) result += "һδ޶ʱڷֽ⣩";
+}
+
+/**
+** ȥĿհףӦڱʽеλ
+** @param arg 
+** @param offset λ
+** @return ȥհ׺Ĳ
+*/
+std::string TrimArgument(const std::string& arg, size_t& offset)
+{
+	size_t first = arg.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos) return std::string();
+
+	size_t last = arg.find_last_not_of(" \t\r\n");
+	offset += first;
+	return arg.substr(first, last - first + 1);
+}
+
+/**
+** õһֵ
+** @param call зֺĵ
+** @param index 
+** @param value 
+** @param result ʱдظ
+** @return Ƿɹ
+*/
+bool CalculateArgument(const CallExpr& call, size_t index, double& value, std::string& result)
+{
+	Expected<double> calc = CalculateExpr(call.args[index]);
+	if (!calc)
+	{
+		CalcError error = calc.Error();
+		error.position += call.offsets[index];
+		result = CalcErrorMessage(error);
+		return false;
+	}
+
+	value = calc.Value();
+	return true;
+}
+
+/**
+** еĺʽʽҲдɡ=ұߡķ̣ ()-(ұ) 
+** @param call зֺĵ
+** @param index ʽţһΪ
+** @param program 
+** @param variable д
+** @param result ʱдظ
+** @return Ƿɹ
+*/
+bool CompileArgument(const CallExpr& call, size_t index, Program& program, std::string& variable, std::string& result)
+{
+	size_t variable_offset = call.offsets[index + 1];
+	variable = TrimArgument(call.args[index + 1], variable_offset);
+	if (!IsValidVariable(variable))
+	{
+		result = CalcErrorMessage(CalcError{ CalcErrc::kUnknownToken, variable_offset });
+		return false;
+	}
+
+	const std::string& function = call.args[index];
+	size_t equals = function.find('=');
+	std::string expr = function;
+	if (equals != std::string::npos)
+		expr = "(" + function.substr(0, equals) + ")-(" + function.substr(equals + 1) + ")";
+
+	Expected<Program> compiled = CompileExpr(expr, variable);
+	if (!compiled)
+	{
+		//λûԭıʽ
+		CalcError error = compiled.Error();
+		if (equals != std::string::npos)
+		{
+			if (error.position >= equals + 4)
+				error.position -= 3;
+			else if (error.position > equals)
+				error.position = equals;
+			else if (error.position > 0)
+				error.position -= 1;
+		}
+		error.position += call.offsets[index];
+		result = CalcErrorMessage(error);
+		return false;
+	}
+
+	program = compiled.Value();
+	return true;
+}
+
+/**
+** ʽΪ solve(ʽ, , , յ)
+** @param call зֺĵ
+** @param result ظ
+** @return ɹʱtrueʱfalse
+*/
+bool DisposeSolve(const CallExpr& call, std::string& result)
+{
+	if (call.args.size() != 4)
+	{
+		result = CalcErrorMessage(CalcError{ CalcErrc::kWrongArgumentCount, call.position });
+		return false;
+	}
+
+	Program program;
+	std::string variable;
+	double a, b;
+	if (!CompileArgument(call, 0, program, variable, result)
+		|| !CalculateArgument(call, 2, a, result) || !CalculateArgument(call, 3, b, result))
+		return false;
+
+	Expected<util_solve::Roots> roots = util_solve::Solve(program, a, b);
+	if (!roots)
+	{
+		result = CalcErrorMessage(CalcError{ roots.Error().code, call.offsets[2] });
+		return false;
+	}
+
+	const std::vector<double>& values = roots.Value().values;
+	if (values.empty())
+	{
+		result = "ûҵ";
+	}
+	else
+	{
+		result = variable + " =";
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			//-0Ϊ0
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.15g", values[i] + 0.0);
+			result += i == 0 ? " " : ", ";
+			result += buf;
+		}
+	}
+
+	if (roots.Value().incomplete) result += "ƣڿܻδгĸ";
+	return true;
+}
+
+/**
+** ֣ʽΪ integrate(, , , )
+** @param call зֺĵ
+** @param result ظ
+** @return ɹʱtrueʱfalse
+*/
+bool DisposeIntegrate(const CallExpr& call, std::string& result)
+{
+	if (call.args.size() != 4)
+	{
+		result = CalcErrorMessage(CalcError{ CalcErrc::kWrongArgumentCount, call.position });
+		return false;
+	}
+
+	Program program;
+	std::string variable;
+	double a, b;
+	if (!CompileArgument(call, 0, program, variable, result)
+		|| !CalculateArgument(call, 2, a, result) || !CalculateArgument(call, 3, b, result))
+		return false;
+
+	Expected<util_integrate::Integral> integral = util_integrate::Integrate(program, a, b);
+	if (!integral)
+	{
+		//ʱָޣԱ޶
+		size_t index = integral.Error().code == CalcErrc::kOverflow ? 2 : 0;
+		size_t offset = call.offsets[index];
+		TrimArgument(call.args[index], offset);
+		result = CalcErrorMessage(CalcError{ integral.Error().code, offset });
+		return false;
+	}
+
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.15g", integral.Value().value);
+	result = std::string(" = ") + buf;
+
+	if (!integral.Value().converged)
+	{
+		snprintf(buf, sizeof(buf), "%.2g", integral.Value().error);
+		result += std::string("δﵽҪ󣬹 ") + buf + "ֿܷɢ";
+	}
+	return true;
+}
+
 bool Dispose(int32_t type, int64_t from_discuss, int64_t from_qq, std::string msg, std::string& result)
 {
-	static std::string cmd = "";
+	static const std::string default_cmd = "";
+
+	static const std::string default_factor_cmd = "ֽ";
+
+	//Ϣʹͬһÿգڼ¼ҲӰ
+	util_config::Reader config;
+	const std::string& cmd = config->command.empty() ? default_cmd : config->command;
+	const std::string& factor_cmd = config->factor_command.empty() ? default_factor_cmd : config->factor_command;
 
 	size_t index = util_kmp::KMP_Find(msg.c_str(), cmd.c_str());
 
-	if (index == util_kmp::npos) return false;
+	if (index == util_kmp::npos)
+	{
+		size_t factor_index = util_kmp::KMP_Find(msg.c_str(), factor_cmd.c_str());
+		if (factor_index == util_kmp::npos) return false;
+
+		DisposeFactor(msg.substr(factor_index + factor_cmd.length()), result);
+		return true;
+	}
 
+	//ʽ֮ʼƱֻڱʽ֮
+	size_t index_begin = index + cmd.length();
+
+	//-> ơתƣ-> dec-> decȡʹʮ㣬ȳ18λʱʹ⾫
+	//-> λ㵥λ硰5km -> mi
 	int to_bit = 0;
-	size_t index_end = util_kmp::KMP_Find(msg.c_str(), "->");
+	int decimal_digits = 0;
+	std::string unit_target;
+	size_t target_offset = 0;
+	size_t index_end = util_kmp::KMP_Find(msg.c_str() + index_begin, "->");
 	if (index_end == util_kmp::npos)
 	{
 		index_end = msg.length();
 	}
 	else
 	{
-		to_bit = atoi(msg.c_str() + index_end + 2);
-		if (to_bit < 2 || to_bit > 36)
-		{
-			result = "ȷĽƷΧ[2,36]";
-			return true;
-		}
-	}
+		index_end += index_begin;
+		const char* mark = msg.c_str() + index_end + 2;
+		while (*mark == ' ') ++mark;
 
-	result = "0";
-	try {
-		double calc = CalculateExpr(msg.substr(index + cmd.length(), index_end - cmd.length()));
-		if (calc != 0)
+		if (strncmp(mark, "dec", 3) == 0)
 		{
-			if (to_bit == 0 || to_bit == 10)
+			const char* digits = mark + 3;
+			while (*digits == ' ') ++digits;
+			decimal_digits = isdigit(static_cast<unsigned char>(*digits)) ? atoi(digits) : util_decimal::kDefaultDigits;
+			if (decimal_digits < 1 || decimal_digits > config->max_digits)
 			{
-				result = std::to_string(calc);
-				RemoveExcessZero(result);
+				result = "ȷľȣΧ[1," + std::to_string(config->max_digits) + "]";
+				return true;
 			}
-			else
+		}
+		else if (isalpha(static_cast<unsigned char>(*mark)))
+		{
+			unit_target = mark;
+			unit_target.erase(unit_target.find_last_not_of(' ') + 1);
+			target_offset = static_cast<size_t>(mark - msg.c_str()) - index_begin;
+		}
+		else
+		{
+			to_bit = atoi(mark);
+			if (to_bit < config->min_radix || to_bit > config->max_radix)
 			{
-				calc = abs(calc);
-				if (calc > 1) result = ToBit(static_cast<uint64_t>(calc), to_bit);
+				result = "ȷĽƷΧ[" + std::to_string(config->min_radix) + "," + std::to_string(config->max_radix) + "]";
+				return true;
 			}
 		}
 	}
-	catch (const char* error_msg)
+
+	std::string expr = msg.substr(index_begin, index_end - index_begin);
+
+	//ͬıʽƣ򾫶ȡĿ굥λֱӴӳ־ûȡĿ굥λĸͷ
+	std::string cache_key;
+	if (!unit_target.empty())
+		cache_key = unit_target + "|" + expr;
+	else if (decimal_digits != 0)
+		cache_key = "dec" + std::to_string(decimal_digits) + "|" + expr;
+	else
+		cache_key = std::to_string(to_bit) + "|" + expr;
+	if (util_cache::Find(cache_key, result)) return true;
+
+	if (!unit_target.empty())
+	{
+		Expected<double> converted = ConvertUnits(expr, unit_target, target_offset);
+		if (!converted)
+		{
+			result = CalcErrorMessage(converted.Error());
+			return true;
+		}
+
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%.15g", converted.Value());
+		result = std::string(buf) + " " + unit_target;
+		util_cache::Store(cache_key, result);
+		return true;
+	}
+
+	CallExpr call;
+	if (to_bit == 0 && decimal_digits == 0 && MatchCall(expr, "solve", call))
+	{
+		if (DisposeSolve(call, result)) util_cache::Store(cache_key, result);
+		return true;
+	}
+	if (to_bit == 0 && decimal_digits == 0 && MatchCall(expr, "integrate", call))
+	{
+		if (DisposeIntegrate(call, result)) util_cache::Store(cache_key, result);
+		return true;
+	}
+
+	if (decimal_digits > util_decimal::kMaxDigits)
+	{
+		Expected<util_big::Float> big = CalculateBig(expr, decimal_digits);
+		if (!big)
+		{
+			result = CalcErrorMessage(big.Error());
+			return true;
+		}
+
+		result = util_big::Format(big.Value(), decimal_digits);
+		util_cache::Store(cache_key, result);
+		return true;
+	}
+
+	if (decimal_digits != 0)
+	{
+		Expected<util_decimal::Decimal> decimal = CalculateDecimal(expr, decimal_digits);
+		if (!decimal)
+		{
+			result = CalcErrorMessage(decimal.Error());
+			return true;
+		}
+
+		result = util_decimal::Format(decimal.Value());
+		util_cache::Store(cache_key, result);
+		return true;
+	}
+
+	Expected<double> calc = CalculateExpr(expr);
+	if (!calc)
 	{
-		result = error_msg;
+		result = CalcErrorMessage(calc.Error());
+		return true;
 	}
-	
+
+	result = "0";
+	double value = calc.Value();
+	if (value != 0)
+	{
+		if (to_bit == 0 || to_bit == 10)
+		{
+			result = std::to_string(value);
+			RemoveExcessZero(result);
+		}
+		else
+		{
+			value = fabs(value);
+			if (value > 1) result = ToBit(static_cast<uint64_t>(value), to_bit);
+		}
+	}
+	util_cache::Store(cache_key, result);
+
 	return true;
 }
\ No newline at end of file
@@ -0,0 +1,1250 @@
+#include "bigfloat.h"
+#include <algorithm>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+using util_big::Context;
+using util_big::Float;
+
+typedef std::vector<uint32_t> Limbs;
+
+static const uint32_t kBase = 10000;
+//内部计算比有效数字多出的10000进制保护位数
+static const size_t kGuardLimbs = 3;
+//表示不限制精度，用于二分递归求和中的精确整数运算
+static const size_t kExact = static_cast<size_t>(-1);
+//计算π、e时使用的计算量上限，最高精度下π约需2e8
+static const uint64_t kConstantBudget = 500000000ULL;
+//指数（10000进制位数）的绝对值上限
+static const int64_t kMaxExponent = 1LL << 50;
+//两个乘数都不少于此位数时使用NTT乘法
+static const size_t kNttThreshold = 48;
+
+//NTT模数，两者之积约为10^18，可以容纳长度2^21以内的卷积系数
+static const uint32_t kMod1 = 998244353;
+static const uint32_t kMod2 = 1004535809;
+static const uint32_t kPrimitiveRoot = 3;
+
+//计算过的常数，精度不够时重新计算并替换
+struct CachedConstant
+{
+	size_t limbs;
+	Float value;
+};
+
+static std::mutex constant_mutex;
+static CachedConstant cached_pi = { 0, Float() };
+static CachedConstant cached_e = { 0, Float() };
+
+template <uint32_t kMod>
+static uint64_t PowMod32(uint64_t base, uint64_t exponent)
+{
+	uint64_t result = 1;
+	base %= kMod;
+	while (exponent)
+	{
+		if (exponent & 1) result = result * base % kMod;
+		base = base * base % kMod;
+		exponent >>= 1;
+	}
+	return result;
+}
+
+/**
+** 原地数论变换，长度必须是2的幂
+** @param invert 为true时做逆变换
+*/
+template <uint32_t kMod>
+static void Ntt(Limbs& a, bool invert)
+{
+	size_t n = a.size();
+	for (size_t i = 1, j = 0; i < n; ++i)
+	{
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1) j ^= bit;
+		j ^= bit;
+		if (i < j) std::swap(a[i], a[j]);
+	}
+
+	Limbs roots;
+	for (size_t len = 2; len <= n; len <<= 1)
+	{
+		uint64_t step = PowMod32<kMod>(kPrimitiveRoot, (kMod - 1) / len);
+		if (invert) step = PowMod32<kMod>(step, kMod - 2);
+
+		size_t half = len >> 1;
+		roots.resize(half);
+		roots[0] = 1;
+		for (size_t k = 1; k < half; ++k) roots[k] = static_cast<uint32_t>(roots[k - 1] * step % kMod);
+
+		for (size_t i = 0; i < n; i += len)
+		{
+			for (size_t k = 0; k < half; ++k)
+			{
+				uint32_t u = a[i + k];
+				uint32_t v = static_cast<uint32_t>(static_cast<uint64_t>(a[i + k + half]) * roots[k] % kMod);
+				a[i + k] = u + v >= kMod ? u + v - kMod : u + v;
+				a[i + k + half] = u >= v ? u - v : u + kMod - v;
+			}
+		}
+	}
+
+	if (invert)
+	{
+		uint64_t n_inverse = PowMod32<kMod>(n, kMod - 2);
+		for (uint32_t& x : a) x = static_cast<uint32_t>(x * n_inverse % kMod);
+	}
+}
+
+/**
+** 在模kMod下计算两个序列的循环卷积，a与b相同时只做一次正变换
+*/
+template <uint32_t kMod>
+static void Convolve(const uint32_t* a, size_t n, const uint32_t* b, size_t m, size_t size, Limbs& out)
+{
+	Limbs fa(a, a + n);
+	fa.resize(size);
+	Ntt<kMod>(fa, false);
+
+	if (a == b && n == m)
+	{
+		for (size_t i = 0; i < size; ++i) fa[i] = static_cast<uint32_t>(static_cast<uint64_t>(fa[i]) * fa[i] % kMod);
+	}
+	else
+	{
+		Limbs fb(b, b + m);
+		fb.resize(size);
+		Ntt<kMod>(fb, false);
+		for (size_t i = 0; i < size; ++i) fa[i] = static_cast<uint32_t>(static_cast<uint64_t>(fa[i]) * fb[i] % kMod);
+	}
+
+	Ntt<kMod>(fa, true);
+	out.swap(fa);
+}
+
+/**
+** 两个10000进制自然数相乘，结果不含高位的0
+*/
+static void MulNat(Context& ctx, const uint32_t* a, size_t n, const uint32_t* b, size_t m, Limbs& result)
+{
+	if (n < kNttThreshold || m < kNttThreshold)
+	{
+		ctx.Charge(static_cast<uint64_t>(n) * m);
+
+		//每个位置最多累加min(n, m)个小于10^8的乘积，64位不会溢出
+		std::vector<uint64_t> acc(n + m, 0);
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (a[i] == 0) continue;
+			for (size_t j = 0; j < m; ++j) acc[i + j] += static_cast<uint64_t>(a[i]) * b[j];
+		}
+
+		result.resize(n + m);
+		uint64_t carry = 0;
+		for (size_t k = 0; k < n + m; ++k)
+		{
+			uint64_t v = acc[k] + carry;
+			result[k] = static_cast<uint32_t>(v % kBase);
+			carry = v / kBase;
+		}
+	}
+	else
+	{
+		size_t size = 1, bits = 0;
+		while (size < n + m)
+		{
+			size <<= 1;
+			++bits;
+		}
+		ctx.Charge(static_cast<uint64_t>(size) * bits * 6);
+
+		Limbs r1, r2;
+		Convolve<kMod1>(a, n, b, m, size, r1);
+		Convolve<kMod2>(a, n, b, m, size, r2);
+
+		//中国剩余定理合并两个模数下的结果：x = r1 + kMod1 * ((r2 - r1) * kMod1^-1 mod kMod2)
+		const uint64_t inverse = PowMod32<kMod2>(kMod1, kMod2 - 2);
+		result.resize(n + m);
+		uint64_t carry = 0;
+		for (size_t k = 0; k < n + m; ++k)
+		{
+			uint64_t t = (r2[k] + kMod2 - r1[k] % kMod2) % kMod2 * inverse % kMod2;
+			uint64_t v = r1[k] + kMod1 * t + carry;
+			result[k] = static_cast<uint32_t>(v % kBase);
+			carry = v / kBase;
+		}
+	}
+
+	while (!result.empty() && result.back() == 0) result.pop_back();
+}
+
+static bool IsZero(const Float& x)
+{
+	return x.mantissa.empty();
+}
+
+/**
+** 数值小于 10000^Top
+*/
+static int64_t Top(const Float& x)
+{
+	return x.exponent + static_cast<int64_t>(x.mantissa.size());
+}
+
+/**
+** 去掉尾数高位与低位的0
+*/
+static void Normalize(Float& x)
+{
+	Limbs& m = x.mantissa;
+	while (!m.empty() && m.back() == 0) m.pop_back();
+
+	size_t low = 0;
+	while (low < m.size() && m[low] == 0) ++low;
+	if (low != 0)
+	{
+		m.erase(m.begin(), m.begin() + low);
+		x.exponent += static_cast<int64_t>(low);
+	}
+
+	if (m.empty())
+	{
+		x.negative = false;
+		x.exponent = 0;
+	}
+}
+
+/**
+** 截断到最高的limbs位
+*/
+static void Truncate(Float& x, size_t limbs)
+{
+	if (limbs == kExact || x.mantissa.size() <= limbs) return;
+
+	size_t drop = x.mantissa.size() - limbs;
+	x.mantissa.erase(x.mantissa.begin(), x.mantissa.begin() + drop);
+	x.exponent += static_cast<int64_t>(drop);
+	Normalize(x);
+}
+
+static Float FromUint64(uint64_t value)
+{
+	Float result;
+	while (value)
+	{
+		result.mantissa.push_back(static_cast<uint32_t>(value % kBase));
+		value /= kBase;
+	}
+	Normalize(result);
+	return result;
+}
+
+/**
+** 取最高的3位作为双精度浮点数，x约等于 返回值 * 10000^scale
+*/
+static double Leading(const Float& x, int64_t& scale)
+{
+	size_t n = x.mantissa.size();
+	size_t take = n < 3 ? n : 3;
+	double value = 0;
+	for (size_t i = 0; i < take; ++i) value = value * kBase + x.mantissa[n - 1 - i];
+	scale = x.exponent + static_cast<int64_t>(n - take);
+	return x.negative ? -value : value;
+}
+
+static double ToDouble(const Float& x)
+{
+	int64_t scale;
+	double value = Leading(x, scale);
+	return value * pow(static_cast<double>(kBase), static_cast<double>(scale));
+}
+
+/**
+** 将已对齐到low位的尾数写入数组
+*/
+static void Place(const Float& x, int64_t low, Limbs& out)
+{
+	for (size_t i = 0; i < x.mantissa.size(); ++i)
+	{
+		int64_t position = x.exponent + static_cast<int64_t>(i) - low;
+		if (position >= 0) out[static_cast<size_t>(position)] = x.mantissa[i];
+	}
+}
+
+/**
+** 计算 a + b，b的符号由b_negative指定，结果截断到prec位
+*/
+static void AddSigned(Context& ctx, const Float& a, const Float& b, bool b_negative, size_t prec, Float& result)
+{
+	if (IsZero(b))
+	{
+		result = a;
+		Truncate(result, prec);
+		return;
+	}
+	if (IsZero(a))
+	{
+		result = b;
+		result.negative = b_negative;
+		Truncate(result, prec);
+		return;
+	}
+
+	int64_t top = std::max(Top(a), Top(b));
+	int64_t low = std::min(a.exponent, b.exponent);
+	//比精度范围低两位以上的部分不影响截断后的结果
+	if (prec != kExact) low = std::max(low, top - static_cast<int64_t>(prec) - 2);
+
+	size_t n = static_cast<size_t>(top - low) + 1;
+	ctx.Charge(n);
+
+	Limbs x(n, 0), y(n, 0);
+	Place(a, low, x);
+	Place(b, low, y);
+
+	bool negative = a.negative;
+	if (a.negative == b_negative)
+	{
+		uint32_t carry = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			uint32_t v = x[i] + y[i] + carry;
+			carry = v >= kBase ? 1 : 0;
+			x[i] = v - carry * kBase;
+		}
+	}
+	else
+	{
+		//大减小，结果取较大者的符号
+		size_t i = n;
+		while (i > 0 && x[i - 1] == y[i - 1]) --i;
+		if (i > 0 && x[i - 1] < y[i - 1])
+		{
+			x.swap(y);
+			negative = b_negative;
+		}
+
+		uint32_t borrow = 0;
+		for (size_t k = 0; k < n; ++k)
+		{
+			uint32_t subtrahend = y[k] + borrow;
+			borrow = x[k] < subtrahend ? 1 : 0;
+			x[k] = x[k] + borrow * kBase - subtrahend;
+		}
+	}
+
+	result.negative = negative;
+	result.exponent = low;
+	result.mantissa.swap(x);
+	Normalize(result);
+	Truncate(result, prec);
+}
+
+/**
+** 计算 a * b，结果截断到prec位
+*/
+static void MulFloat(Context& ctx, const Float& a, const Float& b, size_t prec, Float& result)
+{
+	if (IsZero(a) || IsZero(b))
+	{
+		result = Float();
+		return;
+	}
+
+	//只需要乘积的最高prec位，乘数多余的低位先截掉
+	const uint32_t* pa = a.mantissa.data();
+	const uint32_t* pb = b.mantissa.data();
+	size_t na = a.mantissa.size(), nb = b.mantissa.size();
+	int64_t exponent = a.exponent + b.exponent;
+	if (prec != kExact && na > prec + 1)
+	{
+		pa += na - prec - 1;
+		exponent += static_cast<int64_t>(na - prec - 1);
+		na = prec + 1;
+	}
+	if (prec != kExact && nb > prec + 1)
+	{
+		pb += nb - prec - 1;
+		exponent += static_cast<int64_t>(nb - prec - 1);
+		nb = prec + 1;
+	}
+
+	bool negative = a.negative != b.negative;
+	Limbs product;
+	MulNat(ctx, pa, na, pb, nb, product);
+
+	result.negative = negative;
+	result.exponent = exponent;
+	result.mantissa.swap(product);
+	Normalize(result);
+	Truncate(result, prec);
+}
+
+/**
+** 原地乘以小整数
+*/
+static void MulSmall(Context& ctx, Float& x, uint32_t k)
+{
+	ctx.Charge(x.mantissa.size());
+
+	uint64_t carry = 0;
+	for (uint32_t& limb : x.mantissa)
+	{
+		uint64_t v = static_cast<uint64_t>(limb) * k + carry;
+		limb = static_cast<uint32_t>(v % kBase);
+		carry = v / kBase;
+	}
+	while (carry)
+	{
+		x.mantissa.push_back(static_cast<uint32_t>(carry % kBase));
+		carry /= kBase;
+	}
+	Normalize(x);
+}
+
+/**
+** 除以小整数，结果截断到prec位
+*/
+static void DivSmall(Context& ctx, const Float& x, uint32_t d, size_t prec, Float& result)
+{
+	if (IsZero(x))
+	{
+		result = Float();
+		return;
+	}
+
+	//低位补0使商有足够的位数
+	size_t size = x.mantissa.size();
+	size_t extra = prec != kExact && size < prec + 1 ? prec + 1 - size : 0;
+	ctx.Charge(size + extra);
+
+	Limbs quotient(size + extra);
+	uint64_t remainder = 0;
+	for (size_t i = size + extra; i-- > 0;)
+	{
+		uint64_t current = remainder * kBase + (i >= extra ? x.mantissa[i - extra] : 0);
+		quotient[i] = static_cast<uint32_t>(current / d);
+		remainder = current % d;
+	}
+
+	result.negative = x.negative;
+	result.exponent = x.exponent - static_cast<int64_t>(extra);
+	result.mantissa.swap(quotient);
+	Normalize(result);
+	Truncate(result, prec);
+}
+
+/**
+** 解析十进制数字，结果截断到prec位
+** @param allow_sign 是否允许开头和指数部分带符号
+*/
+static bool ParseText(const char* p, const char* end, bool allow_sign, size_t prec, Float& value)
+{
+	bool negative = false;
+	if (allow_sign && p != end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	std::string digits;
+	int64_t exponent = 0;
+	bool any = false, point = false;
+	for (; p != end; ++p)
+	{
+		if (*p == '.')
+		{
+			if (point) return false;
+			point = true;
+			continue;
+		}
+		if (*p < '0' || *p > '9') break;
+
+		any = true;
+		if (point) --exponent;
+		//跳过开头的0
+		if (!digits.empty() || *p != '0') digits.push_back(*p);
+	}
+	if (!any) return false;
+
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool exponent_negative = false;
+		if (allow_sign && p != end && (*p == '-' || *p == '+'))
+		{
+			exponent_negative = *p == '-';
+			++p;
+		}
+		if (p == end) return false;
+
+		int64_t e = 0;
+		for (; p != end; ++p)
+		{
+			if (*p < '0' || *p > '9') return false;
+			if (e <= kMaxExponent * 8) e = e * 10 + (*p - '0');
+		}
+		exponent += exponent_negative ? -e : e;
+	}
+	if (p != end) return false;
+
+	//十进制指数对齐到4的倍数
+	int64_t pad = (exponent % 4 + 4) % 4;
+	digits.append(static_cast<size_t>(pad), '0');
+	exponent -= pad;
+
+	Float result;
+	result.negative = negative;
+	result.exponent = exponent / 4;
+	for (size_t last = digits.size(); last > 0;)
+	{
+		size_t first = last >= 4 ? last - 4 : 0;
+		uint32_t limb = 0;
+		for (size_t i = first; i < last; ++i) limb = limb * 10 + (digits[i] - '0');
+		result.mantissa.push_back(limb);
+		last = first;
+	}
+	Normalize(result);
+	Truncate(result, prec);
+	if (!IsZero(result) && (result.exponent > kMaxExponent || result.exponent < -kMaxExponent)) return false;
+
+	value.negative = result.negative;
+	value.exponent = result.exponent;
+	value.mantissa.swap(result.mantissa);
+	return true;
+}
+
+static Float FromDouble(double value)
+{
+	char buf[40];
+	snprintf(buf, sizeof(buf), "%.16e", value);
+
+	Float result;
+	ParseText(buf, buf + strlen(buf), true, kExact, result);
+	return result;
+}
+
+/**
+** 舍入到digits位有效数字，得到十进制数字串（不含末尾的0）与十进制指数
+*/
+static void DecimalDigits(const Float& x, int digits, std::string& text, int64_t& exponent)
+{
+	const Limbs& m = x.mantissa;
+	text = std::to_string(m.back());
+	text.reserve(m.size() * 4);
+	for (size_t i = m.size() - 1; i-- > 0;)
+	{
+		char buf[4];
+		uint32_t limb = m[i];
+		for (int k = 3; k >= 0; --k)
+		{
+			buf[k] = static_cast<char>('0' + limb % 10);
+			limb /= 10;
+		}
+		text.append(buf, 4);
+	}
+	exponent = x.exponent * 4;
+
+	if (text.size() > static_cast<size_t>(digits))
+	{
+		bool up = text[digits] >= '5';
+		exponent += static_cast<int64_t>(text.size()) - digits;
+		text.resize(static_cast<size_t>(digits));
+		if (up)
+		{
+			int i = digits - 1;
+			while (i >= 0 && text[i] == '9')
+			{
+				text[i] = '0';
+				--i;
+			}
+			if (i >= 0)
+			{
+				++text[i];
+			}
+			else
+			{
+				text.insert(text.begin(), '1');
+				text.pop_back();
+				++exponent;
+			}
+		}
+	}
+
+	while (text.size() > 1 && text.back() == '0')
+	{
+		text.pop_back();
+		++exponent;
+	}
+}
+
+/**
+** 计算 1 / b，结果截断到prec位
+** 将b缩放到[1, 10000)后用牛顿迭代 y = y + y * (1 - b * y)，每次迭代精度翻倍
+*/
+static void Recip(Context& ctx, const Float& b, size_t prec, Float& result)
+{
+	int64_t shift = Top(b) - 1;
+	Float x = b;
+	x.negative = false;
+	x.exponent -= shift;
+
+	Float y = FromDouble(1 / ToDouble(x));
+	Float one = FromUint64(1), t;
+	size_t p = 2;
+	for (;;)
+	{
+		p = std::min(p * 2, prec);
+		MulFloat(ctx, x, y, p + 1, t);
+		AddSigned(ctx, one, t, !t.negative, p + 1, t);
+		MulFloat(ctx, y, t, p + 1, t);
+		AddSigned(ctx, y, t, t.negative, p + 1, y);
+		if (p >= prec || ctx.Exhausted()) break;
+	}
+
+	y.exponent -= shift;
+	y.negative = b.negative;
+	Truncate(y, prec);
+	result = y;
+}
+
+/**
+** 计算平方根，x必须非负
+** 将x按10000的偶数次幂缩放到[1, 10000^2)，牛顿迭代求 1/sqrt(x) 后乘以x
+*/
+static void SqrtFloat(Context& ctx, const Float& x, size_t prec, Float& result)
+{
+	if (IsZero(x))
+	{
+		result = Float();
+		return;
+	}
+
+	int64_t top = Top(x) - 1;
+	int64_t half = top >= 0 ? top / 2 : -((1 - top) / 2);
+	Float xs = x;
+	xs.exponent -= 2 * half;
+
+	Float y = FromDouble(1 / sqrt(ToDouble(xs)));
+	Float one = FromUint64(1), t;
+	size_t p = 2;
+	for (;;)
+	{
+		//y = y + y * (1 - xs * y^2) / 2
+		p = std::min(p * 2, prec);
+		MulFloat(ctx, y, y, p + 1, t);
+		MulFloat(ctx, xs, t, p + 1, t);
+		AddSigned(ctx, one, t, !t.negative, p + 1, t);
+		MulFloat(ctx, y, t, p + 1, t);
+		DivSmall(ctx, t, 2, p + 1, t);
+		AddSigned(ctx, y, t, t.negative, p + 1, y);
+		if (p >= prec || ctx.Exhausted()) break;
+	}
+
+	MulFloat(ctx, xs, y, prec, result);
+	result.exponent += half;
+}
+
+/**
+** 二分递归求 sum(prod(c / i, i = a+1..n), n = a+1..b) = T/Q，P = c^(b-a)
+*/
+static void ExpSplit(Context& ctx, const Float& c, uint64_t a, uint64_t b, Float& p, Float& q, Float& t)
+{
+	if (b - a == 1)
+	{
+		p = c;
+		q = FromUint64(b);
+		t = c;
+		return;
+	}
+
+	uint64_t m = (a + b) / 2;
+	Float p2, q2, t2;
+	ExpSplit(ctx, c, a, m, p, q, t);
+	ExpSplit(ctx, c, m, b, p2, q2, t2);
+
+	//T = T1 * Q2 + P1 * T2，P = P1 * P2，Q = Q1 * Q2
+	MulFloat(ctx, t, q2, kExact, t);
+	MulFloat(ctx, p, t2, kExact, t2);
+	AddSigned(ctx, t, t2, t2.negative, kExact, t);
+	MulFloat(ctx, p, p2, kExact, p);
+	MulFloat(ctx, q, q2, kExact, q);
+}
+
+/**
+** 计算 e^x，结果截断到prec位
+** 参数先除以2^s使绝对值小于1/2，再按小数位分段 r = c0 + c1 + ...，第k段取第2^(k-1)+1到第2^k位
+** 每段的级数用二分递归精确求和，段越靠后数值越小、需要的项数越少（bit-burst算法），最后平方s次
+*/
+static CalcErrc ExpFloat(Context& ctx, const Float& x, size_t prec, Float& result)
+{
+	Float one = FromUint64(1);
+	if (IsZero(x))
+	{
+		result = one;
+		return CalcErrc::kOk;
+	}
+
+	double magnitude = fabs(ToDouble(x));
+	if (!(magnitude < 1e12)) return CalcErrc::kOverflow;
+
+	int s = magnitude >= 0.5 ? static_cast<int>(ceil(log2(magnitude))) + 1 : 0;
+	//平方s次会放大舍入误差，参数的整数部分越大需要的有效位数越多
+	size_t w = prec + static_cast<size_t>(s * 0.30103 / 4) + static_cast<size_t>(log10(magnitude + 1) / 4) + 2;
+
+	Float r = x;
+	Truncate(r, w);
+	for (int left = s; left > 0;)
+	{
+		int step = left < 30 ? left : 30;
+		DivSmall(ctx, r, 1u << step, w + 1, r);
+		left -= step;
+	}
+
+	//e^r = 各段 (Q + T) / Q 之积，分子分母分别累乘，最后做一次除法
+	Float numerator = one, denominator = one, chunk, p, q, t;
+	for (size_t begin = 0, length = 1; begin < w; begin += length, length = begin)
+	{
+		int64_t low = -static_cast<int64_t>(begin + length), high = -static_cast<int64_t>(begin);
+		chunk = Float();
+		for (size_t i = 0; i < r.mantissa.size(); ++i)
+		{
+			int64_t position = r.exponent + static_cast<int64_t>(i);
+			if (position < low || position >= high) continue;
+			if (chunk.mantissa.empty()) chunk.exponent = position;
+			chunk.mantissa.push_back(r.mantissa[i]);
+		}
+		Normalize(chunk);
+		if (IsZero(chunk)) continue;
+		chunk.negative = r.negative;
+
+		//项数取到 |c|^n / n! 小于 10000^-w
+		int64_t scale;
+		double lead = log10(fabs(Leading(chunk, scale))) + 4.0 * scale;
+		double term = 0, limit = -4.0 * static_cast<double>(w) - 2;
+		uint64_t n = 0;
+		while (term > limit) term += lead - log10(static_cast<double>(++n));
+
+		ExpSplit(ctx, chunk, 0, n, p, q, t);
+		if (ctx.Exhausted()) return CalcErrc::kBudgetExceeded;
+		AddSigned(ctx, q, t, t.negative, w, t);
+		MulFloat(ctx, numerator, t, w, numerator);
+		MulFloat(ctx, denominator, q, w, denominator);
+	}
+
+	Float sum;
+	Recip(ctx, denominator, w, sum);
+	MulFloat(ctx, numerator, sum, w, sum);
+	for (int i = 0; i < s; ++i)
+	{
+		MulFloat(ctx, sum, sum, w, sum);
+		if (ctx.Exhausted()) return CalcErrc::kBudgetExceeded;
+	}
+
+	Truncate(sum, prec);
+	result = sum;
+	return CalcErrc::kOk;
+}
+
+/**
+** 计算 ln(x)，x必须为正数
+** 牛顿迭代 y = y + x * e^-y - 1，每次迭代精度翻倍
+*/
+static CalcErrc LnFloat(Context& ctx, const Float& x, size_t prec, Float& result)
+{
+	Float one = FromUint64(1), d;
+
+	//x接近1时结果接近0，按x-1开头的0增加有效位数
+	AddSigned(ctx, x, one, true, kExact, d);
+	if (IsZero(d))
+	{
+		result = Float();
+		return CalcErrc::kOk;
+	}
+
+	int64_t scale;
+	double lead = Leading(x, scale);
+	double y0 = log(lead) + scale * log(static_cast<double>(kBase));
+	size_t w = prec + static_cast<size_t>(log10(fabs(y0) + 1) / 4) + 1;
+	if (Top(d) < 0) w += static_cast<size_t>(-Top(d));
+
+	Float y = FromDouble(y0), e, t;
+	size_t p = 2;
+	for (;;)
+	{
+		p = std::min(p * 2, w);
+
+		Float minus_y = y;
+		minus_y.negative = !IsZero(y) && !y.negative;
+		CalcErrc code = ExpFloat(ctx, minus_y, p + 1, e);
+		if (code != CalcErrc::kOk) return code;
+
+		MulFloat(ctx, x, e, p + 1, t);
+		AddSigned(ctx, t, one, true, p + 1, t);
+		AddSigned(ctx, y, t, t.negative, p + 1, y);
+		if (p >= w) break;
+	}
+
+	Truncate(y, prec);
+	result = y;
+	return CalcErrc::kOk;
+}
+
+/**
+** 向零取整
+*/
+static void TruncateInteger(const Float& x, Float& result)
+{
+	result = x;
+	if (result.exponent >= 0) return;
+
+	size_t drop = static_cast<size_t>(-result.exponent);
+	if (drop >= result.mantissa.size())
+	{
+		result = Float();
+		return;
+	}
+	result.mantissa.erase(result.mantissa.begin(), result.mantissa.begin() + drop);
+	result.exponent = 0;
+	Normalize(result);
+}
+
+/**
+** 计算 |a| mod |b|，商的整数部分超出精度时无法得到准确的余数
+*/
+static CalcErrc RemMagnitude(Context& ctx, const Float& a, const Float& b, size_t prec, Float& result)
+{
+	Float x = a, y = b, q, t;
+	x.negative = false;
+	y.negative = false;
+
+	Recip(ctx, y, prec + 1, q);
+	MulFloat(ctx, x, q, prec + 1, q);
+	if (Top(q) > static_cast<int64_t>(prec)) return CalcErrc::kDomainError;
+	TruncateInteger(q, q);
+
+	//按求得的商精确计算余数，商可能相差1，余数超出[0, |b|)时修正
+	MulFloat(ctx, y, q, kExact, t);
+	AddSigned(ctx, x, t, true, kExact, t);
+	if (t.negative)
+	{
+		AddSigned(ctx, t, y, false, kExact, t);
+	}
+	else
+	{
+		AddSigned(ctx, t, y, true, kExact, q);
+		if (!q.negative) t = q;
+	}
+
+	Truncate(t, prec);
+	result = t;
+	return CalcErrc::kOk;
+}
+
+/**
+** 二分递归求Chudnovsky级数第[a, b)项的P、Q、T
+*/
+static void ChudnovskySplit(Context& ctx, uint64_t a, uint64_t b, Float& p, Float& q, Float& t)
+{
+	if (b - a == 1)
+	{
+		if (a == 0)
+		{
+			p = FromUint64(1);
+			q = FromUint64(1);
+		}
+		else
+		{
+			p = FromUint64(6 * a - 5);
+			MulSmall(ctx, p, static_cast<uint32_t>(2 * a - 1));
+			MulSmall(ctx, p, static_cast<uint32_t>(6 * a - 1));
+
+			//a^3 * 640320^3 / 24
+			q = FromUint64(a);
+			MulSmall(ctx, q, static_cast<uint32_t>(a));
+			MulSmall(ctx, q, static_cast<uint32_t>(a));
+			MulSmall(ctx, q, 26680);
+			MulSmall(ctx, q, 640320);
+			MulSmall(ctx, q, 640320);
+		}
+
+		MulFloat(ctx, p, FromUint64(13591409 + 545140134 * a), kExact, t);
+		t.negative = (a & 1) != 0;
+		return;
+	}
+
+	uint64_t m = (a + b) / 2;
+	Float p2, q2, t2;
+	ChudnovskySplit(ctx, a, m, p, q, t);
+	ChudnovskySplit(ctx, m, b, p2, q2, t2);
+
+	//T = Q2 * T1 + P1 * T2，P = P1 * P2，Q = Q1 * Q2
+	MulFloat(ctx, t, q2, kExact, t);
+	MulFloat(ctx, p, t2, kExact, t2);
+	AddSigned(ctx, t, t2, t2.negative, kExact, t);
+	MulFloat(ctx, p, p2, kExact, p);
+	MulFloat(ctx, q, q2, kExact, q);
+}
+
+/**
+** 二分递归求 sum(a!/k!, k = a+1..b) = P/Q
+*/
+static void FactorialSplit(Context& ctx, uint64_t a, uint64_t b, Float& p, Float& q)
+{
+	if (b - a == 1)
+	{
+		p = FromUint64(1);
+		q = FromUint64(b);
+		return;
+	}
+
+	uint64_t m = (a + b) / 2;
+	Float p2, q2;
+	FactorialSplit(ctx, a, m, p, q);
+	FactorialSplit(ctx, m, b, p2, q2);
+
+	//P = P1 * Q2 + P2，Q = Q1 * Q2
+	MulFloat(ctx, p, q2, kExact, p);
+	AddSigned(ctx, p, p2, false, kExact, p);
+	MulFloat(ctx, q, q2, kExact, q);
+}
+
+static bool FindConstant(CachedConstant& constant, size_t limbs, Float& result)
+{
+	std::lock_guard<std::mutex> lock(constant_mutex);
+	if (constant.limbs < limbs) return false;
+
+	result = constant.value;
+	Truncate(result, limbs);
+	return true;
+}
+
+static void StoreConstant(CachedConstant& constant, size_t limbs, const Float& value)
+{
+	std::lock_guard<std::mutex> lock(constant_mutex);
+	if (constant.limbs >= limbs) return;
+
+	constant.limbs = limbs;
+	constant.value = value;
+}
+
+static CalcErrc CheckRange(const Context& ctx, const Float& x)
+{
+	if (ctx.Exhausted()) return CalcErrc::kBudgetExceeded;
+	if (!IsZero(x) && (Top(x) > kMaxExponent || x.exponent < -kMaxExponent)) return CalcErrc::kOverflow;
+	return CalcErrc::kOk;
+}
+
+Context::Context(int digits)
+	: digits_(digits), limbs_(static_cast<size_t>(digits + 3) / 4 + kGuardLimbs), work_(0), budget_(kWorkBudget)
+{
+}
+
+bool Context::Parse(const char* begin, const char* end, Float& value)
+{
+	return ParseText(begin, end, false, limbs_, value);
+}
+
+Float Context::FromInt64(int64_t value)
+{
+	Float result = FromUint64(value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+	result.negative = value < 0;
+	return result;
+}
+
+bool Context::ToInt64(const Float& value, int64_t& result)
+{
+	if (IsZero(value))
+	{
+		result = 0;
+		return true;
+	}
+
+	//最低位不为0，指数为负说明有小数部分
+	if (value.exponent < 0 || Top(value) > 5) return false;
+
+	uint64_t magnitude = 0;
+	for (int64_t i = Top(value) - 1; i >= 0; --i)
+	{
+		uint32_t limb = i >= value.exponent ? value.mantissa[static_cast<size_t>(i - value.exponent)] : 0;
+		if (magnitude > (UINT64_MAX - limb) / kBase) return false;
+		magnitude = magnitude * kBase + limb;
+	}
+	if (magnitude > (value.negative ? 1ULL << 63 : (1ULL << 63) - 1)) return false;
+
+	result = value.negative ? -static_cast<int64_t>(magnitude - 1) - 1 : static_cast<int64_t>(magnitude);
+	return true;
+}
+
+Float Context::FromScaled(int64_t coefficient, int64_t exponent)
+{
+	static const uint32_t kPow10[4] = { 1, 10, 100, 1000 };
+
+	Float result = FromInt64(coefficient);
+	int64_t pad = (exponent % 4 + 4) % 4;
+	MulSmall(*this, result, kPow10[pad]);
+	if (!IsZero(result)) result.exponent += (exponent - pad) / 4;
+	return result;
+}
+
+bool Context::ToScaled(const Float& value, int digits, int64_t& coefficient, int64_t& exponent)
+{
+	if (IsZero(value))
+	{
+		coefficient = 0;
+		exponent = 0;
+		return true;
+	}
+
+	std::string text;
+	DecimalDigits(value, digits, text, exponent);
+	coefficient = 0;
+	for (char ch : text) coefficient = coefficient * 10 + (ch - '0');
+	if (value.negative) coefficient = -coefficient;
+	return true;
+}
+
+CalcErrc Context::Add(const Float& a, const Float& b, Float& result)
+{
+	AddSigned(*this, a, b, b.negative, limbs_, result);
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Sub(const Float& a, const Float& b, Float& result)
+{
+	AddSigned(*this, a, b, !IsZero(b) && !b.negative, limbs_, result);
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Mul(const Float& a, const Float& b, Float& result)
+{
+	MulFloat(*this, a, b, limbs_, result);
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Div(const Float& a, const Float& b, Float& result)
+{
+	if (IsZero(b)) return CalcErrc::kDivideByZero;
+
+	Float reciprocal;
+	Recip(*this, b, limbs_ + 1, reciprocal);
+	MulFloat(*this, a, reciprocal, limbs_, result);
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Rem(const Float& a, const Float& b, Float& result)
+{
+	Float x, y;
+	TruncateInteger(a, x);
+	TruncateInteger(b, y);
+	if (IsZero(y)) return CalcErrc::kDivideByZero;
+
+	CalcErrc code = RemMagnitude(*this, x, y, limbs_, result);
+	if (code != CalcErrc::kOk) return code;
+
+	//结果与被除数同号
+	result.negative = !IsZero(result) && x.negative;
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Mod(const Float& a, const Float& b, Float& result)
+{
+	if (IsZero(b)) return CalcErrc::kDivideByZero;
+
+	Float r;
+	CalcErrc code = RemMagnitude(*this, a, b, limbs_, r);
+	if (code != CalcErrc::kOk) return code;
+
+	//余数与除数异号时加上除数，使结果与除数同号
+	r.negative = !IsZero(r) && a.negative;
+	if (!IsZero(r) && a.negative != b.negative)
+		AddSigned(*this, r, b, b.negative, limbs_, r);
+
+	result = r;
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Pow(const Float& a, const Float& b, Float& result)
+{
+	int64_t n;
+	if (ToInt64(b, n))
+	{
+		if (IsZero(a))
+		{
+			if (n < 0) return CalcErrc::kDivideByZero;
+			result = n == 0 ? FromUint64(1) : Float();
+			return CalcErrc::kOk;
+		}
+
+		//快速幂每次乘法都有舍入误差，按指数的位数增加保护位
+		uint64_t k = n < 0 ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n);
+		size_t w = limbs_ + static_cast<size_t>(log2(static_cast<double>(k)) / 13) + 1;
+		Float power = FromUint64(1), base = a;
+		while (k)
+		{
+			if (k & 1) MulFloat(*this, power, base, w, power);
+			k >>= 1;
+			if (k == 0) break;
+
+			MulFloat(*this, base, base, w, base);
+			CalcErrc code = CheckRange(*this, base);
+			if (code != CalcErrc::kOk) return code;
+		}
+
+		if (n < 0)
+		{
+			Recip(*this, power, limbs_, result);
+		}
+		else
+		{
+			Truncate(power, limbs_);
+			result = power;
+		}
+		return CheckRange(*this, result);
+	}
+
+	if (IsZero(a))
+	{
+		if (b.negative) return CalcErrc::kDivideByZero;
+		result = Float();
+		return CalcErrc::kOk;
+	}
+	if (a.negative) return CalcErrc::kDomainError;
+
+	//a^b = e^(b * ln(a))
+	Float l;
+	CalcErrc code = LnFloat(*this, a, limbs_ + 1, l);
+	if (code != CalcErrc::kOk) return code;
+	MulFloat(*this, l, b, limbs_ + 1, l);
+	code = ExpFloat(*this, l, limbs_, result);
+	if (code != CalcErrc::kOk) return code;
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Sqrt(const Float& x, Float& result)
+{
+	if (x.negative) return CalcErrc::kDomainError;
+
+	SqrtFloat(*this, x, limbs_, result);
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Exp(const Float& x, Float& result)
+{
+	CalcErrc code = ExpFloat(*this, x, limbs_, result);
+	if (code != CalcErrc::kOk) return code;
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Ln(const Float& x, Float& result)
+{
+	if (x.negative || IsZero(x)) return CalcErrc::kDomainError;
+
+	CalcErrc code = LnFloat(*this, x, limbs_, result);
+	if (code != CalcErrc::kOk) return code;
+	return CheckRange(*this, result);
+}
+
+CalcErrc Context::Pi(Float& result)
+{
+	if (FindConstant(cached_pi, limbs_, result)) return CalcErrc::kOk;
+
+	//结果会被缓存，计算量有固定上限，使用单独的上下文，不占用本次计算的预算
+	Context series(digits_);
+	series.budget_ = kConstantBudget;
+
+	//pi = 426880 * sqrt(10005) * Q / T，每项约增加14.18位有效数字
+	uint64_t terms = static_cast<uint64_t>(limbs_ * 4 / 14.181647462725477) + 2;
+	Float p, q, t, root;
+	ChudnovskySplit(series, 0, terms, p, q, t);
+	if (series.Exhausted()) return CalcErrc::kBudgetExceeded;
+
+	SqrtFloat(series, FromUint64(10005), limbs_ + 1, root);
+	MulSmall(series, q, 426880);
+	MulFloat(series, q, root, limbs_ + 1, q);
+	Recip(series, t, limbs_ + 1, t);
+	MulFloat(series, q, t, limbs_, result);
+	if (series.Exhausted()) return CalcErrc::kBudgetExceeded;
+
+	StoreConstant(cached_pi, limbs_, result);
+	return CalcErrc::kOk;
+}
+
+CalcErrc Context::E(Float& result)
+{
+	if (FindConstant(cached_e, limbs_, result)) return CalcErrc::kOk;
+
+	Context series(digits_);
+	series.budget_ = kConstantBudget;
+
+	//取足够多的项，使 n! 超过 10^(有效位数)
+	double needed = static_cast<double>(limbs_) * 4 + 1, sum = 0;
+	uint64_t terms = 1;
+	while (sum < needed) sum += log10(static_cast<double>(++terms));
+
+	Float p, q;
+	FactorialSplit(series, 0, terms, p, q);
+	if (series.Exhausted()) return CalcErrc::kBudgetExceeded;
+
+	//e = 1 + P / Q
+	Recip(series, q, limbs_ + 1, q);
+	MulFloat(series, p, q, limbs_ + 1, p);
+	AddSigned(series, p, FromUint64(1), false, limbs_, result);
+	if (series.Exhausted()) return CalcErrc::kBudgetExceeded;
+
+	StoreConstant(cached_e, limbs_, result);
+	return CalcErrc::kOk;
+}
+
+std::string util_big::Format(const Float& value, int digits)
+{
+	if (IsZero(value)) return "0";
+
+	std::string text;
+	int64_t exponent;
+	DecimalDigits(value, digits, text, exponent);
+
+	int64_t count = static_cast<int64_t>(text.size());
+	int64_t adjusted = exponent + count - 1;
+
+	std::string result;
+	result.reserve(text.size() + 16);
+	if (value.negative) result.push_back('-');
+
+	if (adjusted >= -7 && adjusted < std::max<int64_t>(digits, 21))
+	{
+		if (exponent >= 0)
+		{
+			result += text;
+			result.append(static_cast<size_t>(exponent), '0');
+		}
+		else if (adjusted >= 0)
+		{
+			result.append(text, 0, static_cast<size_t>(adjusted + 1));
+			result.push_back('.');
+			result.append(text, static_cast<size_t>(adjusted + 1), std::string::npos);
+		}
+		else
+		{
+			result.append("0.");
+			result.append(static_cast<size_t>(-adjusted - 1), '0');
+			result += text;
+		}
+	}
+	else
+	{
+		//科学计数法，如1.5e+30
+		result.push_back(text[0]);
+		if (count > 1)
+		{
+			result.push_back('.');
+			result.append(text, 1, std::string::npos);
+		}
+		result.push_back('e');
+		result.push_back(adjusted < 0 ? '-' : '+');
+		result += std::to_string(adjusted < 0 ? -adjusted : adjusted);
+	}
+	return result;
+}
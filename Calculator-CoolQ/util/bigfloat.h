@@ -0,0 +1,127 @@
+#pragma once
+#include "expected.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+** 任意精度浮点数运算
+** 数值表示为 尾数 * 10000^指数，尾数按10000进制从低位到高位存放，运算结果保留指定的有效数字位数
+** 位数较多时大数乘法使用两个模数的数论变换（NTT）
+*/
+namespace util_big {
+	//有效数字位数的上限
+	constexpr int kMaxDigits = 100000;
+	//单次计算允许的计算量，约为0.4秒的单核运算，超出后尽快失败，防止一个请求长期占用线程
+	constexpr uint64_t kWorkBudget = 150000000ULL;
+
+	struct Float
+	{
+		bool negative;
+		int64_t exponent;
+		//为空表示0，最高位与最低位均不为0
+		std::vector<uint32_t> mantissa;
+
+		Float() : negative(false), exponent(0) {}
+	};
+
+	/**
+	** 一次计算的环境，记录精度与已消耗的计算量
+	** 计算量超过上限后，运算尽快结束并返回kBudgetExceeded
+	*/
+	class Context
+	{
+	public:
+		/**
+		** @param digits 有效数字位数（1-kMaxDigits）
+		*/
+		explicit Context(int digits);
+
+		int Digits() const { return digits_; }
+
+		/**
+		** 记录计算量
+		** @return 未超过上限返回true
+		*/
+		bool Charge(uint64_t work)
+		{
+			work_ += work;
+			return work_ <= budget_;
+		}
+
+		bool Exhausted() const { return work_ > budget_; }
+
+		/**
+		** 解析十进制数字，格式为 数字[.数字][e数字]
+		** @return 格式错误时返回false
+		*/
+		bool Parse(const char* begin, const char* end, Float& value);
+
+		Float FromInt64(int64_t value);
+
+		/**
+		** 判断数值是否为可以无损转换为64位整数的整数
+		*/
+		bool ToInt64(const Float& value, int64_t& result);
+
+		/**
+		** 由 coefficient * 10^exponent 构造，用于与十进制浮点数互相转换
+		*/
+		Float FromScaled(int64_t coefficient, int64_t exponent);
+
+		/**
+		** 舍入为 coefficient * 10^exponent 的形式
+		** @param digits 保留的有效数字位数（1-18）
+		** @return 指数超出64位整数范围时返回false
+		*/
+		bool ToScaled(const Float& value, int digits, int64_t& coefficient, int64_t& exponent);
+
+		CalcErrc Add(const Float& a, const Float& b, Float& result);
+		CalcErrc Sub(const Float& a, const Float& b, Float& result);
+		CalcErrc Mul(const Float& a, const Float& b, Float& result);
+		CalcErrc Div(const Float& a, const Float& b, Float& result);
+
+		/**
+		** 取余（%），操作数先向零取整，结果与被除数同号
+		*/
+		CalcErrc Rem(const Float& a, const Float& b, Float& result);
+
+		/**
+		** 取模（mod），结果与除数同号
+		*/
+		CalcErrc Mod(const Float& a, const Float& b, Float& result);
+
+		/**
+		** 乘方，整数指数使用快速幂，其余情况按 exp(b * ln(a)) 计算
+		*/
+		CalcErrc Pow(const Float& a, const Float& b, Float& result);
+
+		CalcErrc Sqrt(const Float& x, Float& result);
+		CalcErrc Exp(const Float& x, Float& result);
+		CalcErrc Ln(const Float& x, Float& result);
+
+		/**
+		** 圆周率，Chudnovsky级数二分递归求和，计算结果在进程内缓存
+		** 常数的计算量只取决于精度，不计入本次计算的预算
+		*/
+		CalcErrc Pi(Float& result);
+
+		/**
+		** 自然常数，阶乘倒数级数二分递归求和，计算结果在进程内缓存
+		** 常数的计算量只取决于精度，不计入本次计算的预算
+		*/
+		CalcErrc E(Float& result);
+
+	private:
+		int digits_;
+		//内部计算使用的10000进制位数，比有效数字多出保护位
+		size_t limbs_;
+		uint64_t work_;
+		uint64_t budget_;
+	};
+
+	/**
+	** 格式化为字符串，舍入到digits位有效数字并去掉多余的0，数量级过大或过小时使用科学计数法
+	*/
+	std::string Format(const Float& value, int digits);
+};
@@ -0,0 +1,315 @@
+#include "config.h"
+#include "bigfloat.h"
+#include "radix.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using util_config::Config;
+
+//检查配置文件的间隔
+static const std::chrono::milliseconds kPollInterval(1000);
+//配置文件大小上限，超过时不读取
+static const long kMaxFileSize = 64 << 10;
+//拥有独立纪元槽位的读取线程数上限，超出的线程共用一个计数
+static const size_t kMaxReaders = 64;
+
+/**
+** 读取线程的纪元槽位，0表示当前没有在读取
+** 每个槽位独占一个缓存行，读取线程之间不会互相干扰
+*/
+struct alignas(64) ReaderSlot
+{
+	std::atomic<uint64_t> epoch;
+	std::atomic<bool> owned;
+};
+
+static ReaderSlot reader_slots[kMaxReaders];
+//没有分到槽位的读取线程中正在读取的个数，不为0时暂停回收
+static std::atomic<size_t> overflow_readers(0);
+static std::atomic<uint64_t> global_epoch(1);
+static std::atomic<const Config*> current(nullptr);
+static const Config default_config;
+
+//以下只由发布配置的线程（Init、监视线程、Shutdown）访问
+static std::mutex writer_mutex;
+static std::vector<std::pair<const Config*, uint64_t>> retired;
+static std::string config_path;
+static std::string loaded_text;
+static std::string pending_text;
+static bool loaded = false;
+static bool pending = false;
+
+static std::mutex watch_mutex;
+static std::condition_variable watch_cv;
+static bool watch_stopping = false;
+static std::thread watcher;
+
+Config::Config()
+	: min_radix(util_radix::kMinRadix), max_radix(util_radix::kMaxRadix), max_digits(util_big::kMaxDigits)
+{
+}
+
+/**
+** 线程第一次读取配置时认领一个槽位，线程退出时归还
+*/
+struct ThreadSlot
+{
+	ReaderSlot* slot;
+	int depth;
+
+	ThreadSlot() : slot(nullptr), depth(0)
+	{
+		for (ReaderSlot& candidate : reader_slots)
+		{
+			bool expected = false;
+			if (candidate.owned.compare_exchange_strong(expected, true))
+			{
+				slot = &candidate;
+				break;
+			}
+		}
+	}
+
+	~ThreadSlot()
+	{
+		if (slot != nullptr) slot->owned.store(false);
+	}
+};
+
+static thread_local ThreadSlot thread_slot;
+
+util_config::Reader::Reader()
+{
+	ThreadSlot& local = thread_slot;
+	if (local.depth++ == 0)
+	{
+		//先公布所在的纪元再读取指针，发布者据此判断旧快照是否还可能被读到
+		if (local.slot != nullptr)
+			local.slot->epoch.store(global_epoch.load());
+		else
+			overflow_readers.fetch_add(1);
+	}
+
+	const Config* config = current.load();
+	config_ = config != nullptr ? config : &default_config;
+}
+
+util_config::Reader::~Reader()
+{
+	ThreadSlot& local = thread_slot;
+	if (--local.depth == 0)
+	{
+		if (local.slot != nullptr)
+			local.slot->epoch.store(0, std::memory_order_release);
+		else
+			overflow_readers.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+/**
+** 释放所有读取者都已离开其纪元的旧快照，调用时需持有writer_mutex
+*/
+static void reclaim()
+{
+	if (retired.empty() || overflow_readers.load() != 0) return;
+
+	uint64_t oldest = UINT64_MAX;
+	for (ReaderSlot& slot : reader_slots)
+	{
+		uint64_t epoch = slot.epoch.load();
+		if (epoch != 0 && epoch < oldest) oldest = epoch;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); ++i)
+	{
+		//快照在纪元推进到retired[i].second之前被替换，此后进入的读取者不会再读到它
+		if (retired[i].second <= oldest)
+			delete retired[i].first;
+		else
+			retired[kept++] = retired[i];
+	}
+	retired.resize(kept);
+}
+
+/**
+** 发布新快照，旧快照记入待回收列表，调用时需持有writer_mutex
+*/
+static void publish(const Config* config)
+{
+	const Config* old = current.exchange(config);
+	if (old != nullptr)
+		retired.emplace_back(old, global_epoch.fetch_add(1) + 1);
+	reclaim();
+}
+
+/**
+** 去掉两端的空白
+*/
+static std::string trim(const std::string& text)
+{
+	size_t first = text.find_first_not_of(" \t\r");
+	if (first == std::string::npos) return std::string();
+	size_t last = text.find_last_not_of(" \t\r");
+	return text.substr(first, last - first + 1);
+}
+
+/**
+** 解析整数配置项，不在范围内时保持原值
+*/
+static void parseInt(const std::string& value, int min, int max, int& result)
+{
+	char* end;
+	long number = strtol(value.c_str(), &end, 10);
+	if (!value.empty() && *end == 0 && number >= min && number <= max)
+		result = static_cast<int>(number);
+}
+
+/**
+** 解析配置文件内容，以;或#开头的行为注释，[节名]行忽略，无法识别的项忽略
+*/
+static Config* parseConfig(const std::string& text)
+{
+	Config* config = new Config();
+
+	size_t begin = 0;
+	//跳过UTF-8的BOM
+	if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) begin = 3;
+
+	while (begin < text.length())
+	{
+		size_t end = text.find('\n', begin);
+		if (end == std::string::npos) end = text.length();
+		std::string line = trim(text.substr(begin, end - begin));
+		begin = end + 1;
+
+		size_t equals = line.find('=');
+		if (line.empty() || line[0] == ';' || line[0] == '#' || line[0] == '[' || equals == std::string::npos)
+			continue;
+
+		std::string key = trim(line.substr(0, equals));
+		std::string value = trim(line.substr(equals + 1));
+		if (key == "command")
+			config->command = value;
+		else if (key == "factor_command")
+			config->factor_command = value;
+		else if (key == "min_radix")
+			parseInt(value, util_radix::kMinRadix, util_radix::kMaxRadix, config->min_radix);
+		else if (key == "max_radix")
+			parseInt(value, util_radix::kMinRadix, util_radix::kMaxRadix, config->max_radix);
+		else if (key == "max_digits")
+			parseInt(value, 1, util_big::kMaxDigits, config->max_digits);
+	}
+
+	if (config->min_radix > config->max_radix)
+	{
+		config->min_radix = util_radix::kMinRadix;
+		config->max_radix = util_radix::kMaxRadix;
+	}
+	return config;
+}
+
+/**
+** 读取整个配置文件
+** @return 文件不存在或过大时返回false
+*/
+static bool readFile(const std::string& path, std::string& text)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr) return false;
+
+	bool ok = fseek(file, 0, SEEK_END) == 0;
+	long size = ok ? ftell(file) : -1;
+	ok = size >= 0 && size <= kMaxFileSize && fseek(file, 0, SEEK_SET) == 0;
+	if (ok)
+	{
+		text.resize(static_cast<size_t>(size));
+		ok = size == 0 || fread(&text[0], 1, text.size(), file) == text.size();
+	}
+
+	fclose(file);
+	return ok;
+}
+
+/**
+** 检查配置文件，内容变化且连续两次检查结果相同时重新解析并发布
+** 编辑器保存文件时可能先清空再写入，等内容稳定后再发布，避免读到写了一半的文件
+*/
+static void reload()
+{
+	std::lock_guard<std::mutex> lock(writer_mutex);
+
+	//文件不存在时按空文件处理，即恢复默认配置
+	std::string text;
+	if (!readFile(config_path, text)) text.clear();
+
+	if (loaded && text == loaded_text)
+	{
+		pending = false;
+		reclaim();
+		return;
+	}
+
+	if (loaded && (!pending || text != pending_text))
+	{
+		pending = true;
+		pending_text.swap(text);
+		return;
+	}
+
+	loaded = true;
+	pending = false;
+	loaded_text.swap(text);
+	publish(parseConfig(loaded_text));
+}
+
+static void watcherMain()
+{
+	std::unique_lock<std::mutex> lock(watch_mutex);
+	while (!watch_cv.wait_for(lock, kPollInterval, [] { return watch_stopping; }))
+	{
+		lock.unlock();
+		reload();
+		lock.lock();
+	}
+}
+
+void util_config::Init(const std::string& path)
+{
+	if (watcher.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		config_path = path;
+		loaded = false;
+	}
+	reload();
+
+	watch_stopping = false;
+	watcher = std::thread(watcherMain);
+}
+
+void util_config::Shutdown()
+{
+	if (watcher.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(watch_mutex);
+			watch_stopping = true;
+		}
+		watch_cv.notify_all();
+		watcher.join();
+	}
+
+	//恢复默认配置，仍在使用中的快照不释放
+	std::lock_guard<std::mutex> lock(writer_mutex);
+	publish(nullptr);
+}
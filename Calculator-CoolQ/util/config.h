@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+
+/**
+** 运行时配置
+** 配置文件为 键=值 格式的文本文件，由后台线程定期检查，内容变化后重新解析
+** 解析结果作为不可变的快照通过原子指针发布，读取时不加锁，也不修改共享的引用计数
+** 旧快照按纪元（epoch）回收：所有读取者都离开旧纪元后才释放
+*/
+namespace util_config {
+	struct Config
+	{
+		//计算命令与分解命令（command、factor_command），与消息使用相同的编码，为空时使用内置的命令
+		std::string command;
+		std::string factor_command;
+		//“-> 进制”允许的进制范围（min_radix、max_radix），在2-36之内
+		int min_radix;
+		int max_radix;
+		//“-> dec精度”允许的最大有效数字位数（max_digits），不超过util_big::kMaxDigits
+		int max_digits;
+
+		Config();
+	};
+
+	/**
+	** 读取配置文件并启动监视线程，配置文件不存在时使用默认配置
+	** @param path 配置文件路径
+	*/
+	void Init(const std::string& path);
+
+	/**
+	** 停止监视线程，应在卸载前调用，调用时不应再有读取配置的线程
+	*/
+	void Shutdown();
+
+	/**
+	** 读取当前配置，对象存在期间快照不会被释放
+	** 同一线程可以嵌套使用；未调用Init时读到默认配置
+	*/
+	class Reader
+	{
+	public:
+		Reader();
+		~Reader();
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		const Config& operator*() const { return *config_; }
+		const Config* operator->() const { return config_; }
+
+	private:
+		const Config* config_;
+	};
+};
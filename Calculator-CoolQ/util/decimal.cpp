@@ -0,0 +1,610 @@
+#include "decimal.h"
+#include "bigfloat.h"
+#include "modmath.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using util_decimal::Decimal;
+using util_decimal::kMaxDigits;
+using util_decimal::kMaxExponent;
+
+static const uint64_t kPow10[20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+	100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+	10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+//格式化时两位一组查表写出数字
+static const char kDigitPairs[] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static uint64_t Magnitude(const Decimal& value)
+{
+	return value.coefficient < 0 ? 0 - static_cast<uint64_t>(value.coefficient) : static_cast<uint64_t>(value.coefficient);
+}
+
+static int Digits64(uint64_t value)
+{
+	int n = 1;
+	while (n < 20 && value >= kPow10[n]) ++n;
+	return n;
+}
+
+static int Digits128(uint64_t hi, uint64_t lo)
+{
+	if (hi == 0) return Digits64(lo);
+
+	uint64_t remainder;
+	uint64_t q_hi = hi / kPow10[19];
+	uint64_t q_lo = util_mod::Div128(hi % kPow10[19], lo, kPow10[19], remainder);
+	return q_hi != 0 ? 39 : 19 + Digits64(q_lo);
+}
+
+/**
+** 计算 magnitude * 10^n 的128位结果
+** @param n 不超过20
+** @param hi 写入结果的高64位
+** @return 结果的低64位
+*/
+static uint64_t MulPow10(uint64_t magnitude, int n, uint64_t& hi)
+{
+	if (n < 20) return util_mod::Mul128(magnitude, kPow10[n], hi);
+
+	uint64_t carry, lo = util_mod::Mul128(magnitude, kPow10[19], hi);
+	lo = util_mod::Mul128(lo, 10, carry);
+	hi = hi * 10 + carry;
+	return lo;
+}
+
+/**
+** 由符号、不超过18位的系数和指数构造十进制数，检查指数范围
+*/
+static CalcErrc Pack(bool negative, uint64_t magnitude, int64_t exponent, Decimal& result)
+{
+	if (magnitude == 0)
+	{
+		result = Decimal{ 0, 0 };
+		return CalcErrc::kOk;
+	}
+
+	//指数越界时先尝试用系数末尾的0或空余的位数抵消
+	while (exponent < -kMaxExponent && magnitude % 10 == 0)
+	{
+		magnitude /= 10;
+		++exponent;
+	}
+	while (exponent > kMaxExponent && magnitude < kPow10[kMaxDigits - 1])
+	{
+		magnitude *= 10;
+		--exponent;
+	}
+	if (exponent < -kMaxExponent || exponent > kMaxExponent)
+		return CalcErrc::kOverflow;
+
+	result.coefficient = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+	result.exponent = static_cast<int32_t>(exponent);
+	return CalcErrc::kOk;
+}
+
+/**
+** 将128位系数按四舍六入五成双舍入到digits位有效数字
+** @param sticky 为true表示真实值比系数多出不足一个单位的尾数，只在需要舍去至少两位时使用
+*/
+static CalcErrc RoundTo(bool negative, uint64_t hi, uint64_t lo, int64_t exponent, bool sticky, int digits, Decimal& result)
+{
+	int excess = Digits128(hi, lo) - digits;
+	if (excess <= 0) return Pack(negative, lo, exponent, result);
+
+	//除最后一位外的多余位分段去掉，只记录是否非零；最后一位作为舍入位
+	while (excess > 1)
+	{
+		int k = excess - 1 < 19 ? excess - 1 : 19;
+		uint64_t remainder, q_hi = hi / kPow10[k];
+		lo = util_mod::Div128(hi % kPow10[k], lo, kPow10[k], remainder);
+		hi = q_hi;
+		sticky = sticky || remainder != 0;
+		excess -= k;
+		exponent += k;
+	}
+
+	uint64_t quotient = lo / 10;
+	uint64_t last = lo % 10;
+	++exponent;
+	if (last > 5 || (last == 5 && (sticky || (quotient & 1)))) ++quotient;
+	if (quotient == kPow10[digits])
+	{
+		quotient /= 10;
+		++exponent;
+	}
+	return Pack(negative, quotient, exponent, result);
+}
+
+/**
+** 解析十进制数字
+** @param allow_sign 是否允许开头和指数部分带符号
+*/
+static bool ParseText(const char* p, const char* end, bool allow_sign, Decimal& value)
+{
+	bool negative = false;
+	if (allow_sign && p != end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	uint64_t coefficient = 0;
+	int digits = 0;
+	int64_t exponent = 0;
+	int round_digit = -1;
+	bool any = false, point = false, sticky = false;
+	for (; p != end; ++p)
+	{
+		if (*p == '.')
+		{
+			if (point) return false;
+			point = true;
+			continue;
+		}
+		if (*p < '0' || *p > '9') break;
+
+		any = true;
+		int digit = *p - '0';
+		if (digits < kMaxDigits)
+		{
+			//跳过开头的0，小数点后的0仍然影响指数
+			if (coefficient != 0 || digit != 0)
+			{
+				coefficient = coefficient * 10 + digit;
+				++digits;
+			}
+			if (point) --exponent;
+		}
+		else
+		{
+			//超出18位的数字只用于舍入
+			if (round_digit < 0)
+				round_digit = digit;
+			else
+				sticky = sticky || digit != 0;
+			if (!point) ++exponent;
+		}
+	}
+	if (!any) return false;
+
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool exponent_negative = false;
+		if (allow_sign && p != end && (*p == '-' || *p == '+'))
+		{
+			exponent_negative = *p == '-';
+			++p;
+		}
+		if (p == end) return false;
+
+		int64_t e = 0;
+		for (; p != end; ++p)
+		{
+			if (*p < '0' || *p > '9') return false;
+			if (e <= kMaxExponent * 4) e = e * 10 + (*p - '0');
+		}
+		exponent += exponent_negative ? -e : e;
+	}
+	if (p != end) return false;
+
+	if (round_digit > 5 || (round_digit == 5 && (sticky || (coefficient & 1)))) ++coefficient;
+	if (coefficient == kPow10[kMaxDigits])
+	{
+		coefficient /= 10;
+		++exponent;
+	}
+	return Pack(negative, coefficient, exponent, value) == CalcErrc::kOk;
+}
+
+/**
+** 向零取整
+*/
+static Decimal Truncate(const Decimal& value)
+{
+	if (value.exponent >= 0) return value;
+	//系数不足18位，此时绝对值小于1
+	if (value.exponent <= -kMaxDigits) return Decimal{ 0, 0 };
+	return Decimal{ value.coefficient / static_cast<int64_t>(kPow10[-value.exponent]), 0 };
+}
+
+/**
+** 计算 (a * 10^a_exp) mod (b * 10^b_exp) 的绝对值
+** @param remainder 写入余数的系数
+** @param exponent 写入余数的指数
+*/
+static void RemMagnitude(uint64_t a, int64_t a_exp, uint64_t b, int64_t b_exp, uint64_t& remainder, int64_t& exponent)
+{
+	if (a_exp >= b_exp)
+	{
+		//a * 10^k mod b 用模幂计算，不需要真正放大a
+		remainder = util_mod::MulMod(a % b, util_mod::PowMod(10, static_cast<uint64_t>(a_exp - b_exp), b), b);
+		exponent = b_exp;
+		return;
+	}
+
+	//b放大后超过64位时一定大于a，余数就是a本身
+	int64_t shift = b_exp - a_exp;
+	uint64_t hi = 1, lo = 0;
+	if (shift <= 20) lo = MulPow10(b, static_cast<int>(shift), hi);
+	remainder = hi == 0 ? a % lo : a;
+	exponent = a_exp;
+}
+
+bool util_decimal::Parse(const char* begin, const char* end, Decimal& value)
+{
+	return ParseText(begin, end, false, value);
+}
+
+Decimal util_decimal::FromInt64(int64_t value)
+{
+	Decimal result;
+	uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+	//64位整数最多19位，舍入后指数不会越界
+	RoundTo(value < 0, 0, magnitude, 0, false, kMaxDigits, result);
+	return result;
+}
+
+CalcErrc util_decimal::FromDouble(double value, Decimal& result)
+{
+	if (isnan(value)) return CalcErrc::kDomainError;
+	if (isinf(value)) return CalcErrc::kOverflow;
+
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.14e", value);
+	return ParseText(buf, buf + strlen(buf), true, result) ? CalcErrc::kOk : CalcErrc::kOverflow;
+}
+
+double util_decimal::ToDouble(const Decimal& value)
+{
+	return strtod(Format(value).c_str(), nullptr);
+}
+
+bool util_decimal::ToInt64(const Decimal& value, int64_t& result)
+{
+	bool negative = value.coefficient < 0;
+	uint64_t magnitude = Magnitude(value);
+	if (magnitude == 0)
+	{
+		result = 0;
+		return true;
+	}
+
+	if (value.exponent >= 0)
+	{
+		if (value.exponent > kMaxDigits) return false;
+		uint64_t hi, lo = util_mod::Mul128(magnitude, kPow10[value.exponent], hi);
+		if (hi != 0 || lo > (negative ? 1ULL << 63 : (1ULL << 63) - 1)) return false;
+		magnitude = lo;
+	}
+	else
+	{
+		if (value.exponent < -kMaxDigits || magnitude % kPow10[-value.exponent] != 0) return false;
+		magnitude /= kPow10[-value.exponent];
+	}
+
+	result = negative ? -static_cast<int64_t>(magnitude - 1) - 1 : static_cast<int64_t>(magnitude);
+	return true;
+}
+
+CalcErrc util_decimal::Add(const Decimal& a, const Decimal& b, Decimal& result)
+{
+	if (b.coefficient == 0)
+	{
+		result = a;
+		return CalcErrc::kOk;
+	}
+	if (a.coefficient == 0)
+	{
+		result = b;
+		return CalcErrc::kOk;
+	}
+
+	//x为指数较大的操作数，对齐到y的指数
+	const Decimal& x = a.exponent >= b.exponent ? a : b;
+	const Decimal& y = a.exponent >= b.exponent ? b : a;
+	bool x_negative = x.coefficient < 0, y_negative = y.coefficient < 0;
+	int64_t shift = static_cast<int64_t>(x.exponent) - y.exponent;
+
+	//x最多放大10^20倍（不超过128位）；差距更大时y舍去的部分不足一个单位，记为sticky
+	int scale = shift < 20 ? static_cast<int>(shift) : 20;
+	uint64_t x_hi, x_lo = MulPow10(Magnitude(x), scale, x_hi);
+	uint64_t y_magnitude = Magnitude(y);
+	bool sticky = false;
+	if (shift > 20)
+	{
+		int64_t drop = shift - 20;
+		if (drop > kMaxDigits)
+		{
+			sticky = true;
+			y_magnitude = 0;
+		}
+		else
+		{
+			sticky = y_magnitude % kPow10[drop] != 0;
+			y_magnitude /= kPow10[drop];
+		}
+	}
+	int64_t exponent = static_cast<int64_t>(x.exponent) - scale;
+
+	uint64_t hi, lo;
+	bool negative;
+	if (x_negative == y_negative)
+	{
+		lo = x_lo + y_magnitude;
+		hi = x_hi + (lo < x_lo ? 1 : 0);
+		negative = x_negative;
+	}
+	else if (x_hi != 0 || x_lo >= y_magnitude)
+	{
+		//y的真实值比y_magnitude多出的尾数使差值向下取整，剩余部分以sticky表示
+		uint64_t subtrahend = y_magnitude + (sticky ? 1 : 0);
+		lo = x_lo - subtrahend;
+		hi = x_hi - (x_lo < subtrahend ? 1 : 0);
+		negative = x_negative;
+	}
+	else
+	{
+		lo = y_magnitude - x_lo;
+		hi = 0;
+		negative = y_negative;
+	}
+
+	return RoundTo(negative, hi, lo, exponent, sticky, kMaxDigits, result);
+}
+
+CalcErrc util_decimal::Sub(const Decimal& a, const Decimal& b, Decimal& result)
+{
+	return Add(a, Decimal{ -b.coefficient, b.exponent }, result);
+}
+
+/**
+** 乘法，exact在结果需要舍入时被置为false
+*/
+static CalcErrc MulTracked(const Decimal& a, const Decimal& b, bool& exact, Decimal& result)
+{
+	uint64_t hi, lo = util_mod::Mul128(Magnitude(a), Magnitude(b), hi);
+	exact = exact && Digits128(hi, lo) <= kMaxDigits;
+	bool negative = (a.coefficient < 0) != (b.coefficient < 0);
+	return RoundTo(negative, hi, lo, static_cast<int64_t>(a.exponent) + b.exponent, false, kMaxDigits, result);
+}
+
+CalcErrc util_decimal::Mul(const Decimal& a, const Decimal& b, Decimal& result)
+{
+	bool exact = true;
+	return MulTracked(a, b, exact, result);
+}
+
+CalcErrc util_decimal::Div(const Decimal& a, const Decimal& b, int digits, Decimal& result)
+{
+	if (b.coefficient == 0) return CalcErrc::kDivideByZero;
+	if (a.coefficient == 0)
+	{
+		result = Decimal{ 0, 0 };
+		return CalcErrc::kOk;
+	}
+
+	bool negative = (a.coefficient < 0) != (b.coefficient < 0);
+	uint64_t dividend = Magnitude(a), divisor = Magnitude(b);
+	int64_t exponent = static_cast<int64_t>(a.exponent) - b.exponent;
+
+	//被除数放大10^shift倍，使商恰好有digits或digits+1位，一次128位除法得到全部数字
+	uint64_t quotient, remainder;
+	int dividend_digits = Digits64(dividend);
+	int shift = digits + Digits64(divisor) - dividend_digits;
+	if (shift > 0)
+	{
+		int first = shift < 19 - dividend_digits ? shift : 19 - dividend_digits;
+		uint64_t hi, lo = util_mod::Mul128(dividend * kPow10[first], kPow10[shift - first], hi);
+		quotient = util_mod::Div128(hi, lo, divisor, remainder);
+		exponent -= shift;
+	}
+	else
+	{
+		quotient = dividend / divisor;
+		remainder = dividend % divisor;
+	}
+
+	int drop = Digits64(quotient) - digits;
+	if (drop > 0)
+	{
+		//舍去商的多余位，余数非零说明舍去部分比看到的略大
+		uint64_t unit = kPow10[drop], dropped = quotient % unit, half = unit / 2;
+		quotient /= unit;
+		exponent += drop;
+		if (dropped > half || (dropped == half && (remainder != 0 || (quotient & 1)))) ++quotient;
+	}
+	else
+	{
+		//余数的两倍与除数比较决定舍入方向，余数小于10^18，乘2不会溢出
+		uint64_t twice = remainder * 2;
+		if (twice > divisor || (twice == divisor && (quotient & 1))) ++quotient;
+	}
+
+	if (quotient == kPow10[digits])
+	{
+		quotient /= 10;
+		++exponent;
+	}
+	return Pack(negative, quotient, exponent, result);
+}
+
+CalcErrc util_decimal::Rem(const Decimal& a, const Decimal& b, Decimal& result)
+{
+	Decimal x = Truncate(a), y = Truncate(b);
+	if (y.coefficient == 0) return CalcErrc::kDivideByZero;
+
+	uint64_t remainder;
+	int64_t exponent;
+	RemMagnitude(Magnitude(x), x.exponent, Magnitude(y), y.exponent, remainder, exponent);
+	return Pack(x.coefficient < 0, remainder, exponent, result);
+}
+
+CalcErrc util_decimal::Mod(const Decimal& a, const Decimal& b, Decimal& result)
+{
+	if (b.coefficient == 0) return CalcErrc::kDivideByZero;
+
+	uint64_t remainder;
+	int64_t exponent;
+	RemMagnitude(Magnitude(a), a.exponent, Magnitude(b), b.exponent, remainder, exponent);
+
+	Decimal r;
+	CalcErrc code = Pack(a.coefficient < 0, remainder, exponent, r);
+	if (code != CalcErrc::kOk) return code;
+
+	//余数与除数异号时加上除数，使结果与除数同号
+	if (r.coefficient != 0 && (a.coefficient < 0) != (b.coefficient < 0))
+		return Add(r, b, result);
+
+	result = r;
+	return CalcErrc::kOk;
+}
+
+CalcErrc util_decimal::Pow(const Decimal& a, const Decimal& b, int digits, Decimal& result)
+{
+	int64_t n;
+	if (!ToInt64(b, n))
+	{
+		double value = pow(ToDouble(a), ToDouble(b));
+		if (isnan(value)) return CalcErrc::kDomainError;
+		return FromDouble(value, result);
+	}
+
+	if (a.coefficient == 0)
+	{
+		if (n < 0) return CalcErrc::kDivideByZero;
+		result = Decimal{ n == 0 ? 1 : 0, 0 };
+		return CalcErrc::kOk;
+	}
+
+	//快速幂，中间结果保留18位有效数字，同时记录是否发生过舍入
+	uint64_t k = n < 0 ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n);
+	Decimal power{ 1, 0 }, base = a;
+	bool exact = true;
+	CalcErrc code;
+	while (k)
+	{
+		if (k & 1)
+		{
+			code = MulTracked(power, base, exact, power);
+			if (code != CalcErrc::kOk) return code;
+		}
+		k >>= 1;
+		if (k == 0) break;
+
+		code = MulTracked(base, base, exact, base);
+		if (code != CalcErrc::kOk) return code;
+	}
+
+	if (exact)
+	{
+		if (n < 0) return Div(Decimal{ 1, 0 }, power, digits, result);
+		return RoundTo(power.coefficient < 0, 0, Magnitude(power), power.exponent, false, digits, result);
+	}
+
+	//中间结果已经舍入过，再舍入到digits位（负指数时再做一次除法）就是两次舍入
+	//改为在带保护位的任意精度下求幂（负指数时求倒数），最后只舍入一次
+	util_big::Context context(kMaxDigits);
+	util_big::Float big;
+	code = context.Pow(context.FromScaled(a.coefficient, a.exponent), context.FromInt64(n), big);
+	if (code != CalcErrc::kOk) return code;
+
+	int64_t coefficient, exponent;
+	if (!context.ToScaled(big, digits, coefficient, exponent)) return CalcErrc::kOverflow;
+
+	//ToScaled遇到恰好一半时远离0舍入，此时结果为奇数说明应当按四舍六入五成双退回一位
+	if (coefficient & 1)
+	{
+		util_big::Float half, diff;
+		half = context.FromScaled(coefficient < 0 ? 5 : -5, exponent - 1);
+		context.Sub(big, context.FromScaled(coefficient, exponent), diff);
+		context.Sub(diff, half, diff);
+		if (diff.mantissa.empty()) coefficient += coefficient < 0 ? 1 : -1;
+	}
+	return Pack(coefficient < 0, Magnitude(Decimal{ coefficient, 0 }), exponent, result);
+}
+
+std::string util_decimal::Format(const Decimal& value)
+{
+	if (value.coefficient == 0) return "0";
+
+	uint64_t magnitude = Magnitude(value);
+	int64_t exponent = value.exponent;
+	while (magnitude % 10 == 0)
+	{
+		magnitude /= 10;
+		++exponent;
+	}
+
+	//从低位开始两位一组写出系数
+	char digits[20];
+	char* p = digits + sizeof(digits);
+	while (magnitude >= 100)
+	{
+		p -= 2;
+		memcpy(p, kDigitPairs + magnitude % 100 * 2, 2);
+		magnitude /= 100;
+	}
+	if (magnitude >= 10)
+	{
+		p -= 2;
+		memcpy(p, kDigitPairs + magnitude * 2, 2);
+	}
+	else
+	{
+		*--p = static_cast<char>('0' + magnitude);
+	}
+
+	int64_t count = digits + sizeof(digits) - p;
+	int64_t adjusted = exponent + count - 1;
+
+	std::string result;
+	result.reserve(32);
+	if (value.coefficient < 0) result.push_back('-');
+
+	if (adjusted >= -7 && adjusted <= 20)
+	{
+		if (exponent >= 0)
+		{
+			result.append(p, static_cast<size_t>(count));
+			result.append(static_cast<size_t>(exponent), '0');
+		}
+		else if (adjusted >= 0)
+		{
+			result.append(p, static_cast<size_t>(adjusted + 1));
+			result.push_back('.');
+			result.append(p + adjusted + 1, static_cast<size_t>(count - adjusted - 1));
+		}
+		else
+		{
+			result.append("0.");
+			result.append(static_cast<size_t>(-adjusted - 1), '0');
+			result.append(p, static_cast<size_t>(count));
+		}
+	}
+	else
+	{
+		//科学计数法，如1.5e+30
+		result.push_back(*p);
+		if (count > 1)
+		{
+			result.push_back('.');
+			result.append(p + 1, static_cast<size_t>(count - 1));
+		}
+		result.push_back('e');
+		result.push_back(adjusted < 0 ? '-' : '+');
+		result += std::to_string(adjusted < 0 ? -adjusted : adjusted);
+	}
+	return result;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "expected.h"
+#include <stdint.h>
+#include <string>
+
+/**
+** 十进制浮点数运算
+** 数值表示为 系数 * 10^指数，系数最多18位十进制数字，因此0.1、0.2等十进制小数可以精确表示
+** 加减乘在结果不超过18位有效数字时是精确的，超过时按四舍六入五成双舍入到18位
+** 除法与乘方按指定的有效数字位数正确舍入
+*/
+namespace util_decimal {
+	//系数的最大有效数字位数
+	constexpr int kMaxDigits = 18;
+	//未指定精度时除法与乘方结果的有效数字位数
+	constexpr int kDefaultDigits = 16;
+	//指数的绝对值上限，超出时报告溢出
+	constexpr int64_t kMaxExponent = 999999999;
+
+	struct Decimal
+	{
+		int64_t coefficient;
+		int32_t exponent;
+	};
+
+	/**
+	** 解析十进制数字，格式为 数字[.数字][e数字]
+	** 有效数字超过18位时舍入
+	** @param begin 起始位置
+	** @param end 结束位置
+	** @param value 解析结果
+	** @return 格式错误或指数超出范围时返回false
+	*/
+	bool Parse(const char* begin, const char* end, Decimal& value);
+
+	/**
+	** 将整数转换为十进制数，超过18位有效数字时舍入
+	*/
+	Decimal FromInt64(int64_t value);
+
+	/**
+	** 将二进制浮点数转换为十进制数，保留15位有效数字（double可以无损往返的位数）
+	** @return 输入为NaN时返回kDomainError，为无穷大时返回kOverflow
+	*/
+	CalcErrc FromDouble(double value, Decimal& result);
+
+	/**
+	** 将十进制数转换为最接近的二进制浮点数
+	*/
+	double ToDouble(const Decimal& value);
+
+	/**
+	** 判断十进制数是否为可以无损转换为64位整数的整数
+	** @param value 输入值
+	** @param result 转换结果
+	** @return 是否可以转换
+	*/
+	bool ToInt64(const Decimal& value, int64_t& result);
+
+	//以下运算出错时返回错误码，结果的指数超出范围时返回kOverflow
+	CalcErrc Add(const Decimal& a, const Decimal& b, Decimal& result);
+	CalcErrc Sub(const Decimal& a, const Decimal& b, Decimal& result);
+	CalcErrc Mul(const Decimal& a, const Decimal& b, Decimal& result);
+
+	/**
+	** 除法，结果正确舍入到digits位有效数字
+	** @param digits 有效数字位数（1-18）
+	*/
+	CalcErrc Div(const Decimal& a, const Decimal& b, int digits, Decimal& result);
+
+	/**
+	** 取余（%），操作数先向零取整，结果与被除数同号
+	*/
+	CalcErrc Rem(const Decimal& a, const Decimal& b, Decimal& result);
+
+	/**
+	** 取模（mod），结果与除数同号
+	*/
+	CalcErrc Mod(const Decimal& a, const Decimal& b, Decimal& result);
+
+	/**
+	** 乘方，整数指数时使用十进制快速幂，结果舍入到digits位有效数字
+	** 快速幂的中间结果超过18位时改用带保护位的任意精度计算，保证结果只舍入一次
+	** 非整数指数时经二进制浮点数计算，结果保留15位有效数字
+	** @param digits 有效数字位数（1-18）
+	*/
+	CalcErrc Pow(const Decimal& a, const Decimal& b, int digits, Decimal& result);
+
+	/**
+	** 格式化为字符串，去掉多余的0，数量级过大或过小时使用科学计数法
+	** @param value 要格式化的数
+	** @return 格式化结果
+	*/
+	std::string Format(const Decimal& value);
+};
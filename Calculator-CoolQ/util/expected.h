@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+
+/**
+** 计算错误码
+*/
+enum class CalcErrc
+{
+	kOk = 0,
+	kMissingOperand,        //运算符缺少操作数
+	kMissingOperator,       //两个操作数之间缺少运算符
+	kUnbalancedParenthesis, //括号不匹配
+	kUnknownToken,          //无法识别的符号
+	kInvalidNumber,         //数字格式错误
+	kWrongArgumentCount,    //函数参数个数错误
+	kDivideByZero,          //除数为0
+	kDomainError,           //操作数超出定义域
+	kNoModularInverse,      //模逆元不存在
+	kOverflow,              //结果超出可表示的范围
+	kBudgetExceeded,        //计算量超过上限
+	kInvalidDigit,          //数位超出进制范围
+	kDimensionMismatch,     //单位的量纲不一致
+	kAffineUnit,            //温度单位不在表达式末尾的数值之后
+};
+
+/**
+** 计算错误，position为出错位置相对表达式开头的字符偏移
+*/
+struct CalcError
+{
+	CalcErrc code;
+	size_t position;
+};
+
+/**
+** 计算结果，要么是值，要么是错误
+** 用于代替异常，使错误输入与正确输入走同样廉价的返回路径
+*/
+template <typename T>
+class Expected
+{
+public:
+	Expected(const T& value) : value_(value), error_{ CalcErrc::kOk, 0 } {}
+	Expected(const CalcError& error) : value_(), error_(error) {}
+
+	bool HasValue() const { return error_.code == CalcErrc::kOk; }
+	explicit operator bool() const { return HasValue(); }
+
+	const T& Value() const { return value_; }
+	T& Value() { return value_; }
+	const CalcError& Error() const { return error_; }
+
+private:
+	T value_;
+	CalcError error_;
+};
@@ -0,0 +1,266 @@
+#include "integrate.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <float.h>
+#include <functional>
+#include <math.h>
+
+using util_integrate::Integral;
+
+//每个小区间的求积节点数
+static const size_t kNodes = 15;
+//一轮新区间的计算量达到该值时分到线程池上并行求值
+static const uint64_t kParallelWork = 1 << 18;
+
+//15点Kronrod公式的节点（正半轴，从大到小，最后一个为中点）与权重，奇数下标的节点同时是7点Gauss公式的节点
+static const double kKronrodNodes[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+static const double kKronrodWeights[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+static const double kGaussWeights[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+/**
+** 一个小区间及其求积结果
+*/
+struct Segment
+{
+	double a, b;
+	double value;
+	double error;
+	//舍入误差的量级，误差估计不超过它的区间再二分也没有意义
+	double roundoff;
+	//区间宽度是否还足以二分
+	bool splittable;
+};
+
+/**
+** 由节点上的函数值计算一个小区间的积分与误差估计，误差估计的修正方法与QUADPACK相同
+** @param segment 小区间，写入计算结果
+** @param f 节点上的函数值，依次为中点、每对对称节点的左右两点
+*/
+static void applyRule(Segment& segment, const double* f)
+{
+	double half = 0.5 * (segment.b - segment.a);
+
+	double fc = f[0];
+	double gauss = fc * kGaussWeights[3];
+	double kronrod = fc * kKronrodWeights[7];
+	double absolute = fabs(kronrod);
+	bool finite = isfinite(fc);
+
+	for (size_t j = 0; j < 7; ++j)
+	{
+		double f1 = f[1 + 2 * j], f2 = f[2 + 2 * j];
+		finite = finite && isfinite(f1) && isfinite(f2);
+		kronrod += kKronrodWeights[j] * (f1 + f2);
+		absolute += kKronrodWeights[j] * (fabs(f1) + fabs(f2));
+		if (j % 2 == 1) gauss += kGaussWeights[j / 2] * (f1 + f2);
+	}
+
+	//被积函数在区间上的平均偏差，用于修正过于保守的误差估计
+	double mean = kronrod * 0.5;
+	double deviation = kKronrodWeights[7] * fabs(fc - mean);
+	for (size_t j = 0; j < 7; ++j)
+	{
+		deviation += kKronrodWeights[j] * (fabs(f[1 + 2 * j] - mean) + fabs(f[2 + 2 * j] - mean));
+	}
+
+	segment.value = finite ? kronrod * half : NAN;
+	absolute *= fabs(half);
+	deviation *= fabs(half);
+	double error = fabs((kronrod - gauss) * half);
+	if (deviation != 0 && error != 0)
+		error = deviation * std::min(1.0, pow(200 * error / deviation, 1.5));
+
+	segment.roundoff = 50 * DBL_EPSILON * absolute;
+	segment.error = std::max(error, segment.roundoff);
+
+	double middle = 0.5 * (segment.a + segment.b);
+	segment.splittable = segment.a < middle && middle < segment.b
+		&& segment.b - segment.a > 100 * DBL_EPSILON * std::max(fabs(segment.a), fabs(segment.b)) + 1000 * DBL_MIN;
+}
+
+/**
+** 对一组小区间批量求值：所有节点放在一起调用一次EvaluateProgram
+** @param program 被积函数
+** @param segments 小区间
+** @param count 小区间个数
+*/
+static void evaluateSegments(const Program& program, Segment* segments, size_t count)
+{
+	std::vector<double> x(count * kNodes), y(count * kNodes), stack;
+	for (size_t i = 0; i < count; ++i)
+	{
+		double center = 0.5 * (segments[i].a + segments[i].b);
+		double half = 0.5 * (segments[i].b - segments[i].a);
+		double* xs = &x[i * kNodes];
+		xs[0] = center;
+		for (size_t j = 0; j < 7; ++j)
+		{
+			xs[1 + 2 * j] = center - half * kKronrodNodes[j];
+			xs[2 + 2 * j] = center + half * kKronrodNodes[j];
+		}
+	}
+
+	EvaluateProgram(program, x.data(), y.data(), x.size(), stack);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		applyRule(segments[i], &y[i * kNodes]);
+	}
+}
+
+/**
+** 求一轮新区间的值，计算量较大时按区间均分给线程池
+*/
+static void evaluateRound(const Program& program, std::vector<Segment>& segments)
+{
+	size_t count = segments.size();
+	size_t concurrency = 1;
+	if (static_cast<uint64_t>(count) * kNodes * program.code.size() >= kParallelWork)
+		concurrency = std::min(util_pool::Concurrency(), count);
+
+	if (concurrency <= 1)
+	{
+		evaluateSegments(program, segments.data(), count);
+		return;
+	}
+
+	std::vector<std::function<void()>> tasks;
+	tasks.reserve(concurrency);
+	for (size_t i = 0; i < concurrency; ++i)
+	{
+		Segment* begin = segments.data() + count * i / concurrency;
+		Segment* end = segments.data() + count * (i + 1) / concurrency;
+		tasks.emplace_back([&program, begin, end] {
+			evaluateSegments(program, begin, end - begin);
+		});
+	}
+	util_pool::Run(tasks);
+}
+
+Expected<Integral> util_integrate::Integrate(const Program& program, double a, double b)
+{
+	if (!isfinite(a) || !isfinite(b))
+		return CalcError{ CalcErrc::kDomainError, 0 };
+	//区间宽度溢出时求积节点全部为inf或NaN
+	if (!isfinite(b - a))
+		return CalcError{ CalcErrc::kOverflow, 0 };
+
+	Integral result;
+	result.value = 0;
+	result.error = 0;
+	result.converged = true;
+	result.evaluations = 0;
+	if (a == b)
+		return result;
+
+	double sign = 1;
+	if (a > b)
+	{
+		std::swap(a, b);
+		sign = -1;
+	}
+
+	uint64_t work = 0;
+	uint64_t segment_work = kNodes * program.code.size();
+	//第一个区间的计算量就超出上限时直接失败，不做任何求值
+	if (segment_work > kWorkBudget)
+		return CalcError{ CalcErrc::kBudgetExceeded, 0 };
+
+	std::vector<Segment> segments(1);
+	segments[0].a = a;
+	segments[0].b = b;
+	work += segment_work;
+	result.evaluations += kNodes;
+	evaluateRound(program, segments);
+
+	std::vector<size_t> order;
+	std::vector<Segment> children;
+	for (;;)
+	{
+		double value = 0, error = 0, roundoff = 0;
+		for (const Segment& segment : segments)
+		{
+			value += segment.value;
+			error += segment.error;
+			roundoff += segment.roundoff;
+		}
+
+		if (!isfinite(value))
+			return CalcError{ CalcErrc::kDomainError, 0 };
+
+		result.value = value;
+		result.error = error;
+
+		//误差估计中舍入误差的部分无法通过继续二分消除
+		double target = std::max(kAbsoluteTolerance, kRelativeTolerance * fabs(value)) + roundoff;
+		if (error <= target)
+			break;
+
+		//从误差最大的区间开始选取，直到选中区间的误差之和足以让剩余误差降到目标以内
+		order.clear();
+		for (size_t i = 0; i < segments.size(); ++i)
+		{
+			if (segments[i].splittable && segments[i].error > segments[i].roundoff)
+				order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [&segments](size_t x, size_t y) {
+			return segments[x].error > segments[y].error;
+		});
+
+		size_t limit = 0;
+		if (work < kWorkBudget)
+			limit = std::min<size_t>(kMaxIntervals - segments.size(), (kWorkBudget - work) / (2 * segment_work));
+		double remaining = error;
+		size_t picked = 0;
+		while (picked < order.size() && picked < limit && remaining > target)
+		{
+			remaining -= segments[order[picked]].error;
+			++picked;
+		}
+
+		if (picked == 0)
+		{
+			//区间无法再二分，或计算量、区间数已达上限
+			result.converged = false;
+			break;
+		}
+
+		children.resize(2 * picked);
+		for (size_t k = 0; k < picked; ++k)
+		{
+			const Segment& parent = segments[order[k]];
+			double middle = 0.5 * (parent.a + parent.b);
+			children[2 * k].a = parent.a;
+			children[2 * k].b = middle;
+			children[2 * k + 1].a = middle;
+			children[2 * k + 1].b = parent.b;
+		}
+
+		work += 2 * picked * segment_work;
+		result.evaluations += 2 * picked * kNodes;
+		evaluateRound(program, children);
+
+		//左半区间替换原区间，右半区间追加在末尾
+		for (size_t k = 0; k < picked; ++k)
+		{
+			segments[order[k]] = children[2 * k];
+			segments.push_back(children[2 * k + 1]);
+		}
+	}
+
+	result.value = result.value * sign + 0.0;
+	return result;
+}
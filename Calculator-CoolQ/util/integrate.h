@@ -0,0 +1,40 @@
+#pragma once
+#include "expected.h"
+#include "rpn.h"
+#include <stdint.h>
+
+/**
+** 一元函数定积分的数值计算
+** 自适应Gauss-Kronrod求积：每个小区间用15点Kronrod公式求值，与其中7点Gauss公式的差作为误差估计
+** 每轮把误差最大的一批小区间二分，新区间的求积节点一次批量求值，点数较多时分到线程池上并行计算
+*/
+namespace util_integrate {
+	//相对误差与绝对误差的目标，总误差估计不超过两者中较大的一个时结束
+	constexpr double kRelativeTolerance = 1e-12;
+	constexpr double kAbsoluteTolerance = 1e-14;
+	//单次积分允许的计算量（求值点数乘以指令条数）
+	constexpr uint64_t kWorkBudget = 100000000;
+	//小区间个数的上限
+	constexpr size_t kMaxIntervals = 50000;
+
+	struct Integral
+	{
+		double value;
+		//误差估计
+		double error;
+		//是否达到精度要求，未达到时积分可能发散或被积函数过于复杂
+		bool converged;
+		//被积函数的求值次数
+		uint64_t evaluations;
+	};
+
+	/**
+	** 计算表达式在[a, b]上的定积分
+	** @param program 编译后的被积函数
+	** @param a 积分下限
+	** @param b 积分上限，可以小于a
+	** @return 积分限不是有限数或被积函数在求积节点上无定义时返回kDomainError，积分区间宽度超出double范围时返回kOverflow，
+	**         被积函数过长使一个区间的求值就超出计算量上限时返回kBudgetExceeded
+	*/
+	Expected<Integral> Integrate(const Program& program, double a, double b);
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 
 namespace util_kmp {
 	constexpr size_t npos = static_cast<size_t>(-1);
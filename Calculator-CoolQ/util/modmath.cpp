@@ -0,0 +1,103 @@
+#include "modmath.h"
+
+uint64_t util_mod::Mod128(uint64_t hi, uint64_t lo, uint64_t m)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 value = (static_cast<unsigned __int128>(hi) << 64) | lo;
+	return static_cast<uint64_t>(value % m);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	//_udiv128要求商不超过64位，先将高位对m取模
+	uint64_t remainder;
+	_udiv128(hi % m, lo, m, &remainder);
+	return remainder;
+#else
+	//逐位移入被除数的移位减法
+	uint64_t remainder = hi % m;
+	for (int i = 63; i >= 0; --i)
+	{
+		bool carry = (remainder >> 63) != 0;
+		remainder = (remainder << 1) | ((lo >> i) & 1);
+		if (carry || remainder >= m) remainder -= m;
+	}
+	return remainder;
+#endif
+}
+
+uint64_t util_mod::Div128(uint64_t hi, uint64_t lo, uint64_t d, uint64_t& remainder)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 value = (static_cast<unsigned __int128>(hi) << 64) | lo;
+	remainder = static_cast<uint64_t>(value % d);
+	return static_cast<uint64_t>(value / d);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return _udiv128(hi, lo, d, &remainder);
+#else
+	uint64_t quotient = 0;
+	remainder = hi;
+	for (int i = 63; i >= 0; --i)
+	{
+		bool carry = (remainder >> 63) != 0;
+		remainder = (remainder << 1) | ((lo >> i) & 1);
+		quotient <<= 1;
+		if (carry || remainder >= d)
+		{
+			remainder -= d;
+			quotient |= 1;
+		}
+	}
+	return quotient;
+#endif
+}
+
+uint64_t util_mod::PowMod(uint64_t base, uint64_t exponent, uint64_t m)
+{
+	if (m == 1) return 0;
+
+	if (m & 1)
+	{
+		Montgomery mont(m);
+		return mont.FromMont(mont.Pow(mont.ToMont(base), exponent));
+	}
+
+	//偶数模数不满足Montgomery条件，使用128位乘积取模的平方乘算法
+	uint64_t result = 1;
+	base %= m;
+	while (exponent)
+	{
+		if (exponent & 1) result = MulMod(result, base, m);
+		base = MulMod(base, base, m);
+		exponent >>= 1;
+	}
+	return result;
+}
+
+bool util_mod::InvMod(uint64_t a, uint64_t m, uint64_t& inverse)
+{
+	if (m == 1)
+	{
+		inverse = 0;
+		return true;
+	}
+
+	//扩展欧几里得算法，系数全部以模m的形式保存，避免有符号溢出
+	uint64_t r0 = m, r1 = a % m;
+	uint64_t t0 = 0, t1 = 1;
+	while (r1 != 0)
+	{
+		uint64_t q = r0 / r1;
+
+		uint64_t r2 = r0 - q * r1;
+		r0 = r1;
+		r1 = r2;
+
+		uint64_t qt = MulMod(q % m, t1, m);
+		uint64_t t2 = t0 >= qt ? t0 - qt : t0 + (m - qt);
+		t0 = t1;
+		t1 = t2;
+	}
+
+	if (r0 != 1) return false;
+
+	inverse = t0;
+	return true;
+}
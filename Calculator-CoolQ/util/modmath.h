@@ -0,0 +1,139 @@
+#pragma once
+#include <stdint.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/**
+** 64位模运算
+** 奇数模数使用Montgomery乘法，其余模数使用128位乘积后取模
+*/
+namespace util_mod {
+	/**
+	** 计算64位乘法的完整128位乘积
+	** @param a 乘数
+	** @param b 乘数
+	** @param hi 写入乘积的高64位
+	** @return 乘积的低64位
+	*/
+	inline uint64_t Mul128(uint64_t a, uint64_t b, uint64_t& hi)
+	{
+#if defined(__SIZEOF_INT128__)
+		unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+		hi = static_cast<uint64_t>(product >> 64);
+		return static_cast<uint64_t>(product);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		return _umul128(a, b, &hi);
+#else
+		uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+		uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+		uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+		uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+		hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+		return (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+	}
+
+	/**
+	** 计算128位整数对64位模数的余数
+	** @param hi 被除数高64位
+	** @param lo 被除数低64位
+	** @param m 模数，不能为0
+	*/
+	uint64_t Mod128(uint64_t hi, uint64_t lo, uint64_t m);
+
+	/**
+	** 计算128位整数除以64位除数的商与余数
+	** @param hi 被除数高64位，必须小于除数
+	** @param lo 被除数低64位
+	** @param d 除数，不能为0
+	** @param remainder 写入余数
+	** @return 商
+	*/
+	uint64_t Div128(uint64_t hi, uint64_t lo, uint64_t d, uint64_t& remainder);
+
+	/**
+	** 计算 a * b mod m
+	*/
+	inline uint64_t MulMod(uint64_t a, uint64_t b, uint64_t m)
+	{
+		uint64_t hi, lo = Mul128(a, b, hi);
+		return Mod128(hi, lo, m);
+	}
+
+	/**
+	** Montgomery乘法上下文，模数必须为奇数
+	** 内部数值均为Montgomery形式 x * 2^64 mod n
+	*/
+	class Montgomery
+	{
+	public:
+		explicit Montgomery(uint64_t n) : n_(n)
+		{
+			//牛顿迭代求 n^-1 mod 2^64，每次迭代有效位数翻倍
+			inverse_ = n;
+			for (int i = 0; i < 5; ++i) inverse_ *= 2 - n * inverse_;
+
+			uint64_t r = (0 - n) % n;
+			r2_ = MulMod(r, r, n);
+			one_ = r;
+		}
+
+		uint64_t Modulus() const { return n_; }
+		uint64_t One() const { return one_; }
+
+		uint64_t Reduce(uint64_t hi, uint64_t lo) const
+		{
+			uint64_t q = lo * inverse_;
+			uint64_t qn_hi;
+			Mul128(q, n_, qn_hi);
+			return hi >= qn_hi ? hi - qn_hi : hi - qn_hi + n_;
+		}
+
+		uint64_t Mul(uint64_t a, uint64_t b) const
+		{
+			uint64_t hi, lo = Mul128(a, b, hi);
+			return Reduce(hi, lo);
+		}
+
+		uint64_t ToMont(uint64_t x) const { return Mul(x % n_, r2_); }
+		uint64_t FromMont(uint64_t x) const { return Reduce(0, x); }
+
+		/**
+		** 快速幂，底数与结果均为Montgomery形式
+		*/
+		uint64_t Pow(uint64_t base, uint64_t exponent) const
+		{
+			uint64_t result = one_;
+			while (exponent)
+			{
+				if (exponent & 1) result = Mul(result, base);
+				base = Mul(base, base);
+				exponent >>= 1;
+			}
+			return result;
+		}
+
+	private:
+		uint64_t n_;
+		uint64_t inverse_;
+		uint64_t r2_;
+		uint64_t one_;
+	};
+
+	/**
+	** 计算 base ^ exponent mod m
+	** @param m 模数，不能为0
+	*/
+	uint64_t PowMod(uint64_t base, uint64_t exponent, uint64_t m);
+
+	/**
+	** 计算模逆元
+	** @param a 要求逆的数
+	** @param m 模数，不能为0
+	** @param inverse 写入 a^-1 mod m
+	** @return a与m不互质时逆元不存在，返回false
+	*/
+	bool InvMod(uint64_t a, uint64_t m, uint64_t& inverse);
+};
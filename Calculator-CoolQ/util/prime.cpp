@@ -0,0 +1,269 @@
+#include "prime.h"
+#include "modmath.h"
+#include <algorithm>
+#include <mutex>
+
+//模30轮：与30互质的8个余数各占一位，一个字节表示30个连续整数
+static const uint8_t kWheelResidues[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+static int8_t wheel_bit[30];
+
+//试除使用的素数上限，超过此范围的因子交由Pollard-rho处理
+static const uint32_t kTrialLimit = 1 << 16;
+//单次分解中Pollard-rho迭代次数的上限
+static const uint64_t kMaxRhoSteps = 1 << 22;
+
+static std::once_flag sieve_once;
+static std::vector<uint8_t> sieve;
+static std::vector<uint32_t> trial_primes;
+
+/**
+** 在筛中将n标记为合数，n必须与30互质
+*/
+static void MarkComposite(uint64_t n)
+{
+	sieve[n / 30] |= static_cast<uint8_t>(1 << wheel_bit[n % 30]);
+}
+
+static bool IsSievedPrime(uint64_t n)
+{
+	if (n < 7) return n == 2 || n == 3 || n == 5;
+	int bit = wheel_bit[n % 30];
+	return bit >= 0 && !(sieve[n / 30] & (1 << bit));
+}
+
+/**
+** 划去p与轮上不小于p的数字的乘积，跳过2、3、5的倍数
+*/
+static void MarkMultiples(uint64_t p)
+{
+	for (uint64_t j = p / 30; ; ++j)
+	{
+		for (int c = 0; c < 8; ++c)
+		{
+			uint64_t q = j * 30 + kWheelResidues[c];
+			if (q < p) continue;
+			uint64_t n = p * q;
+			if (n >= util_prime::kSieveLimit) return;
+			MarkComposite(n);
+		}
+	}
+}
+
+static void BuildSieve()
+{
+	for (int i = 0; i < 30; ++i) wheel_bit[i] = -1;
+	for (int i = 0; i < 8; ++i) wheel_bit[kWheelResidues[i]] = static_cast<int8_t>(i);
+
+	sieve.assign(static_cast<size_t>(util_prime::kSieveLimit / 30 + 1), 0);
+	//1不是素数
+	sieve[0] = 1;
+
+	for (uint64_t p = 7; p * p < util_prime::kSieveLimit; ++p)
+	{
+		if (IsSievedPrime(p)) MarkMultiples(p);
+	}
+
+	trial_primes.clear();
+	for (uint64_t n = 7; n < kTrialLimit; ++n)
+	{
+		if (IsSievedPrime(n)) trial_primes.push_back(static_cast<uint32_t>(n));
+	}
+}
+
+void util_prime::Init()
+{
+	std::call_once(sieve_once, BuildSieve);
+}
+
+/**
+** 以a为底的Miller-Rabin强伪素数测试
+** @return 通过测试返回true
+*/
+static bool MillerRabin(const util_mod::Montgomery& mont, uint64_t a, uint64_t d, int s)
+{
+	uint64_t n = mont.Modulus();
+	a %= n;
+	if (a == 0) return true;
+
+	uint64_t one = mont.One();
+	uint64_t minus_one = n - one;
+	uint64_t x = mont.Pow(mont.ToMont(a), d);
+	if (x == one || x == minus_one) return true;
+
+	for (int i = 1; i < s; ++i)
+	{
+		x = mont.Mul(x, x);
+		if (x == minus_one) return true;
+	}
+	return false;
+}
+
+bool util_prime::IsPrime(uint64_t n)
+{
+	if (n < 2) return false;
+	if (n % 2 == 0 || n % 3 == 0 || n % 5 == 0) return n == 2 || n == 3 || n == 5;
+
+	Init();
+	if (n < kSieveLimit) return IsSievedPrime(n);
+
+	uint64_t d = n - 1;
+	int s = 0;
+	while ((d & 1) == 0)
+	{
+		d >>= 1;
+		++s;
+	}
+
+	//这组底数对所有小于2^64的整数都是确定性的
+	static const uint64_t kBases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+	util_mod::Montgomery mont(n);
+	for (uint64_t a : kBases)
+	{
+		if (!MillerRabin(mont, a, d, s)) return false;
+	}
+	return true;
+}
+
+static uint64_t Gcd(uint64_t a, uint64_t b)
+{
+	while (b)
+	{
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/**
+** Brent改进的Pollard-rho，在Montgomery形式下迭代 x = x^2 + c
+** @param n 奇合数
+** @param budget 剩余迭代次数，会被扣减
+** @return 找到的非平凡因子，超出预算返回0
+*/
+static uint64_t PollardBrent(uint64_t n, uint64_t& budget)
+{
+	const uint64_t kBatch = 128;
+	util_mod::Montgomery mont(n);
+
+	for (uint64_t c_raw = 1; budget > 0; ++c_raw)
+	{
+		uint64_t c = mont.ToMont(c_raw);
+		uint64_t y = mont.ToMont(2), x = y, ys = y;
+		uint64_t q = mont.One();
+		uint64_t g = 1;
+
+		auto f = [&](uint64_t v) {
+			v = mont.Mul(v, v);
+			return v >= n - c ? v - (n - c) : v + c;
+		};
+
+		for (uint64_t r = 1; g == 1; r <<= 1)
+		{
+			x = y;
+			//跳过的r步同样计入预算，否则实际上限接近kMaxRhoSteps的两倍
+			if (r > budget) return 0;
+			budget -= r;
+			for (uint64_t i = 0; i < r; ++i) y = f(y);
+
+			for (uint64_t k = 0; k < r && g == 1; k += kBatch)
+			{
+				ys = y;
+				uint64_t steps = std::min(kBatch, r - k);
+				if (steps > budget) return 0;
+				budget -= steps;
+
+				//累乘差值，每批只做一次gcd
+				for (uint64_t i = 0; i < steps; ++i)
+				{
+					y = f(y);
+					q = mont.Mul(q, x > y ? x - y : y - x);
+				}
+				g = Gcd(q, n);
+			}
+		}
+
+		if (g == n)
+		{
+			//累乘结果为0时回退到本批起点逐步求gcd
+			do
+			{
+				if (budget == 0) return 0;
+				--budget;
+				ys = f(ys);
+				g = Gcd(x > ys ? x - ys : ys - x, n);
+			} while (g == 1);
+		}
+
+		if (g != n) return g;
+	}
+	return 0;
+}
+
+bool util_prime::Factor(uint64_t n, std::vector<std::pair<uint64_t, int>>& factors)
+{
+	Init();
+	factors.clear();
+
+	std::vector<uint64_t> primes;
+	for (uint64_t p : { 2, 3, 5 })
+	{
+		while (n % p == 0)
+		{
+			primes.push_back(p);
+			n /= p;
+		}
+	}
+
+	for (uint32_t p : trial_primes)
+	{
+		if (static_cast<uint64_t>(p) * p > n) break;
+		while (n % p == 0)
+		{
+			primes.push_back(p);
+			n /= p;
+		}
+	}
+
+	bool complete = true;
+	uint64_t unfactored = 1;
+	uint64_t budget = kMaxRhoSteps;
+
+	std::vector<uint64_t> pending;
+	if (n > 1) pending.push_back(n);
+
+	while (!pending.empty())
+	{
+		uint64_t m = pending.back();
+		pending.pop_back();
+
+		//试除已排除小于kTrialLimit的因子，因此小于其平方的剩余部分必为素数
+		if (m < static_cast<uint64_t>(kTrialLimit) * kTrialLimit || IsPrime(m))
+		{
+			primes.push_back(m);
+			continue;
+		}
+
+		uint64_t d = PollardBrent(m, budget);
+		if (d == 0)
+		{
+			complete = false;
+			unfactored *= m;
+			continue;
+		}
+		pending.push_back(d);
+		pending.push_back(m / d);
+	}
+
+	std::sort(primes.begin(), primes.end());
+	for (uint64_t p : primes)
+	{
+		if (!factors.empty() && factors.back().first == p)
+			++factors.back().second;
+		else
+			factors.emplace_back(p, 1);
+	}
+
+	if (!complete) factors.emplace_back(unfactored, 1);
+	return complete;
+}
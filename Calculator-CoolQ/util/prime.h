@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+** 64位整数的素性测试与质因数分解
+*/
+namespace util_prime {
+	//筛法覆盖的范围，此范围内的素性测试直接查表
+	constexpr uint64_t kSieveLimit = 1 << 20;
+
+	/**
+	** 构建模30轮筛，只会执行一次，启动时调用
+	*/
+	void Init();
+
+	/**
+	** 确定性Miller-Rabin素性测试，对所有64位整数结果准确
+	** @param n 要测试的数
+	** @return 是素数返回true
+	*/
+	bool IsPrime(uint64_t n);
+
+	/**
+	** 质因数分解，小因子用试除去除，大因子使用Brent改进的Pollard-rho
+	** 迭代次数有固定上限，保证任意64位输入的最坏耗时
+	** @param n 要分解的数，需大于1
+	** @param factors 按从小到大的顺序写入质因子及其指数
+	** @return 在迭代上限内完成分解返回true，否则最后一项为未能分解的合数
+	*/
+	bool Factor(uint64_t n, std::vector<std::pair<uint64_t, int>>& factors);
+};
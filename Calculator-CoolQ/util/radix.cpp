@@ -0,0 +1,162 @@
+#include "radix.h"
+#include <string.h>
+
+//SWAR要求按小端序读入8个字符，第一个字符在最低字节；MSVC支持的平台都是小端序，其他字节序的平台逐字符解析
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define RADIX_SWAR
+#endif
+
+//每个字节都为1、每个字节只有最高位为1的掩码
+static const uint64_t kOnes = 0x0101010101010101ULL;
+static const uint64_t kHigh = 0x8080808080808080ULL;
+
+/**
+** 逐字节判断是否不小于lo，结果放在每个字节的最高位
+** 要求每个字节都小于0x80，此时加法不会向相邻字节进位
+*/
+inline uint64_t bytesAtLeast(uint64_t x, uint64_t lo)
+{
+	return (x + (0x80 - lo) * kOnes) & kHigh;
+}
+
+/**
+** 逐字节判断是否不大于hi，结果放在每个字节的最高位，要求同bytesAtLeast
+*/
+inline uint64_t bytesAtMost(uint64_t x, uint64_t hi)
+{
+	return ~(x + (0x7F - hi) * kOnes) & kHigh;
+}
+
+/**
+** 单个字符的数位值
+** @return 不是数位时返回-1
+*/
+inline int digitValue(char ch)
+{
+	if (ch >= '0' && ch <= '9') return ch - '0';
+	if (ch >= 'a' && ch <= 'z') return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'Z') return ch - 'A' + 10;
+	return -1;
+}
+
+#ifdef RADIX_SWAR
+/**
+** 同时转换8个字符
+** 先逐字节校验并求出数位值，再两两合并为16位、32位，最后合并为一个整数
+** @param chunk 8个字符，按小端序读入，第一个字符在最低字节
+** @param radix 进制
+** @param radix2 进制的2次方
+** @param radix4 进制的4次方
+** @param digits 写入8个数位组成的整数
+** @return 无效字节的掩码，每个无效字节的最高位为1
+*/
+static uint64_t convertChunk(uint64_t chunk, uint64_t radix, uint64_t radix2, uint64_t radix4, uint64_t& digits)
+{
+	//先去掉最高位再比较，非ASCII字符单独排除
+	uint64_t ascii = ~chunk & kHigh;
+	uint64_t low = chunk & ~kHigh;
+	//数字的0x20位本来就是1，置位后大写字母变为小写字母，其余字符不会落入数字或字母的范围
+	uint64_t lower = low | 0x20 * kOnes;
+
+	uint64_t is_digit = bytesAtLeast(low, '0') & bytesAtMost(low, '9');
+	uint64_t is_letter = bytesAtLeast(lower, 'a') & bytesAtMost(lower, 'z');
+
+	//减法前置最高位，防止向相邻字节借位
+	uint64_t digit_values = ((low | kHigh) - '0' * kOnes) & ((is_digit >> 7) * 0xFF);
+	uint64_t letter_values = ((lower | kHigh) - ('a' - 10) * kOnes) & ((is_letter >> 7) * 0xFF);
+	uint64_t values = (digit_values | letter_values) & ~kHigh;
+
+	uint64_t below_radix = ~bytesAtLeast(values, radix) & kHigh;
+	uint64_t invalid = kHigh & ~(ascii & (is_digit | is_letter) & below_radix);
+	if (invalid != 0) return invalid;
+
+	//相邻数位合并，靠前的字符是高位；每一步的乘积都不会超出所在的16位、32位分段
+	uint64_t pairs = (values & 0x00FF00FF00FF00FFULL) * radix + ((values >> 8) & 0x00FF00FF00FF00FFULL);
+	uint64_t quads = (pairs & 0x0000FFFF0000FFFFULL) * radix2 + ((pairs >> 16) & 0x0000FFFF0000FFFFULL);
+	digits = (quads & 0xFFFFFFFFULL) * radix4 + (quads >> 32);
+	return 0;
+}
+#endif
+
+/**
+** 各进制下乘以进制的1次方、8次方之前数值的上限，超过时结果溢出
+** 预先算好，避免解析过程中做除法
+*/
+struct Limits
+{
+	uint64_t digit[util_radix::kMaxRadix + 1];
+	uint64_t chunk[util_radix::kMaxRadix + 1];
+
+	Limits()
+	{
+		for (int radix = util_radix::kMinRadix; radix <= util_radix::kMaxRadix; ++radix)
+		{
+			uint64_t radix8 = 1;
+			for (int i = 0; i < 8; ++i) radix8 *= radix;
+			digit[radix] = UINT64_MAX / radix;
+			chunk[radix] = UINT64_MAX / radix8;
+		}
+	}
+};
+
+CalcErrc util_radix::Parse(const char* begin, const char* end, int radix, uint64_t& value, size_t& error_offset)
+{
+	value = 0;
+	error_offset = 0;
+	if (begin == end) return CalcErrc::kInvalidNumber;
+
+	static const Limits limits;
+
+	//溢出后继续校验剩余的数位，无效数位优先报告
+	bool overflow = false;
+	const char* iter = begin;
+#ifdef RADIX_SWAR
+	uint64_t radix2 = static_cast<uint64_t>(radix) * radix;
+	uint64_t radix4 = radix2 * radix2;
+	uint64_t radix8 = radix4 * radix4;
+	for (; end - iter >= 8; iter += 8)
+	{
+		uint64_t chunk, digits;
+		memcpy(&chunk, iter, 8);
+		uint64_t invalid = convertChunk(chunk, radix, radix2, radix4, digits);
+		if (invalid != 0)
+		{
+			size_t index = 0;
+			while ((invalid & (0x80ULL << (8 * index))) == 0) ++index;
+			value = 0;
+			error_offset = static_cast<size_t>(iter - begin) + index;
+			return CalcErrc::kInvalidDigit;
+		}
+
+		if (overflow) continue;
+		if (value > limits.chunk[radix] || value * radix8 > UINT64_MAX - digits)
+			overflow = true;
+		else
+			value = value * radix8 + digits;
+	}
+#endif
+
+	for (; iter != end; ++iter)
+	{
+		int digit = digitValue(*iter);
+		if (digit < 0 || digit >= radix)
+		{
+			value = 0;
+			error_offset = static_cast<size_t>(iter - begin);
+			return CalcErrc::kInvalidDigit;
+		}
+
+		if (overflow) continue;
+		if (value > limits.digit[radix] || value * radix > UINT64_MAX - digit)
+			overflow = true;
+		else
+			value = value * radix + digit;
+	}
+
+	if (overflow)
+	{
+		value = 0;
+		return CalcErrc::kOverflow;
+	}
+	return CalcErrc::kOk;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "expected.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+** 任意进制（2-36）整数字面量的解析
+** 每次读入8个字符，用SWAR（寄存器内的SIMD）同时完成8个数位的校验、转换与合并
+*/
+namespace util_radix {
+	constexpr int kMinRadix = 2;
+	constexpr int kMaxRadix = 36;
+
+	/**
+	** 解析无符号整数，数位为0-9、a-z（不区分大小写），数位的值必须小于进制
+	** @param begin 起始位置
+	** @param end 结束位置
+	** @param radix 进制（kMinRadix-kMaxRadix）
+	** @param value 解析结果
+	** @param error_offset 出错时写入出错数位相对begin的偏移
+	** @return 没有数位时返回kInvalidNumber，含有无效数位时返回kInvalidDigit，超出64位无符号整数范围时返回kOverflow
+	*/
+	CalcErrc Parse(const char* begin, const char* end, int radix, uint64_t& value, size_t& error_offset);
+};
@@ -0,0 +1,311 @@
+#include "result_cache.h"
+#include "rpn.h"
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kCacheMagic[8] = { 'C', 'Q', 'C', 'A', 'L', 'C', 'R', 'C' };
+static const uint32_t kCacheFormatVersion = 1;
+static const uint32_t kSlotCount = 1 << 16;
+static const uint32_t kMaxProbe = 8;
+
+struct CacheHeader
+{
+	char magic[8];
+	uint32_t format_version;
+	uint32_t engine_version;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	char reserved[40];
+};
+
+/**
+** 缓存槽位，key_len为0表示从未写入过的空槽（键不能为空）
+** 写入时先清零checksum，最后写入checksum，写入中途崩溃的槽位校验失败后会被跳过，不会截断探测链
+*/
+struct CacheSlot
+{
+	uint64_t checksum;
+	uint32_t hash;
+	uint8_t key_len;
+	uint8_t value_len;
+	uint16_t reserved;
+	char data[240];
+};
+
+static_assert(sizeof(CacheHeader) == 64, "CacheHeader size must be 64");
+static_assert(sizeof(CacheSlot) == 256, "CacheSlot size must be 256");
+
+static const size_t kFileSize = sizeof(CacheHeader) + sizeof(CacheSlot) * static_cast<size_t>(kSlotCount);
+
+//保护映射状态与整个探测过程，所有线程的Find、Store都在这把锁上串行执行
+static std::mutex cache_mutex;
+static std::string cache_path;
+static bool cache_tried = false;
+static char* cache_view = nullptr;
+
+#ifdef _WIN32
+static HANDLE cache_file = INVALID_HANDLE_VALUE;
+static HANDLE cache_mapping = nullptr;
+#else
+static int cache_file = -1;
+#endif
+
+/**
+** FNV-1a 64位哈希
+** @param hash 初始值
+** @param data 数据
+** @param len 数据长度
+*/
+static uint64_t Fnv1a(uint64_t hash, const void* data, size_t len)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t SlotChecksum(const CacheSlot& slot)
+{
+	size_t len = static_cast<size_t>(slot.key_len) + slot.value_len;
+	if (len > sizeof(slot.data)) return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+	hash = Fnv1a(hash, &slot.hash, sizeof(slot.hash));
+	hash = Fnv1a(hash, &slot.key_len, sizeof(slot.key_len));
+	hash = Fnv1a(hash, &slot.value_len, sizeof(slot.value_len));
+	hash = Fnv1a(hash, slot.data, len);
+	//0保留给写入中的槽位
+	return hash ? hash : 1;
+}
+
+static CacheHeader* Header()
+{
+	return reinterpret_cast<CacheHeader*>(cache_view);
+}
+
+static CacheSlot* Slots()
+{
+	return reinterpret_cast<CacheSlot*>(cache_view + sizeof(CacheHeader));
+}
+
+static void UnmapFile()
+{
+#ifdef _WIN32
+	if (cache_view) UnmapViewOfFile(cache_view);
+	if (cache_mapping) CloseHandle(cache_mapping);
+	if (cache_file != INVALID_HANDLE_VALUE) CloseHandle(cache_file);
+	cache_mapping = nullptr;
+	cache_file = INVALID_HANDLE_VALUE;
+#else
+	if (cache_view) munmap(cache_view, kFileSize);
+	if (cache_file != -1) close(cache_file);
+	cache_file = -1;
+#endif
+	cache_view = nullptr;
+}
+
+/**
+** 打开并映射缓存文件，若版本头不匹配则截断文件使旧数据全部失效
+** 打开耗时与文件大小无关，只检查文件头
+** @return 成功返回true
+*/
+static bool MapFile()
+{
+#ifdef _WIN32
+	cache_file = CreateFileA(cache_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (cache_file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(cache_file, &size)) return false;
+
+	bool valid = false;
+	if (size.QuadPart == static_cast<LONGLONG>(kFileSize))
+	{
+		CacheHeader header;
+		DWORD read = 0;
+		valid = ReadFile(cache_file, &header, sizeof(header), &read, nullptr) && read == sizeof(header)
+			&& memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) == 0
+			&& header.format_version == kCacheFormatVersion
+			&& header.engine_version == kEngineVersion
+			&& header.slot_count == kSlotCount
+			&& header.slot_size == sizeof(CacheSlot);
+	}
+
+	if (!valid)
+	{
+		//截断后重新扩展，新扩展的部分由系统保证全部为0
+		LARGE_INTEGER zero = {};
+		size.QuadPart = static_cast<LONGLONG>(kFileSize);
+		if (!SetFilePointerEx(cache_file, zero, nullptr, FILE_BEGIN) || !SetEndOfFile(cache_file)) return false;
+		if (!SetFilePointerEx(cache_file, size, nullptr, FILE_BEGIN) || !SetEndOfFile(cache_file)) return false;
+	}
+
+	cache_mapping = CreateFileMappingA(cache_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (!cache_mapping) return false;
+
+	cache_view = static_cast<char*>(MapViewOfFile(cache_mapping, FILE_MAP_ALL_ACCESS, 0, 0, kFileSize));
+	if (!cache_view) return false;
+#else
+	cache_file = open(cache_path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (cache_file == -1) return false;
+
+	struct stat st;
+	if (fstat(cache_file, &st) != 0) return false;
+
+	bool valid = false;
+	if (st.st_size == static_cast<off_t>(kFileSize))
+	{
+		CacheHeader header;
+		valid = pread(cache_file, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+			&& memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) == 0
+			&& header.format_version == kCacheFormatVersion
+			&& header.engine_version == kEngineVersion
+			&& header.slot_count == kSlotCount
+			&& header.slot_size == sizeof(CacheSlot);
+	}
+
+	if (!valid)
+	{
+		if (ftruncate(cache_file, 0) != 0 || ftruncate(cache_file, static_cast<off_t>(kFileSize)) != 0) return false;
+	}
+
+	void* view = mmap(nullptr, kFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, cache_file, 0);
+	if (view == MAP_FAILED) return false;
+	cache_view = static_cast<char*>(view);
+#endif
+
+	if (!valid)
+	{
+		CacheHeader* header = Header();
+		memcpy(header->magic, kCacheMagic, sizeof(kCacheMagic));
+		header->format_version = kCacheFormatVersion;
+		header->engine_version = kEngineVersion;
+		header->slot_count = kSlotCount;
+		header->slot_size = sizeof(CacheSlot);
+	}
+
+	return true;
+}
+
+/**
+** 确保缓存文件已映射，只会尝试一次
+** @return 映射可用返回true
+*/
+static bool EnsureMapped()
+{
+	if (cache_view) return true;
+	if (cache_tried || cache_path.empty()) return false;
+
+	cache_tried = true;
+	if (!MapFile())
+	{
+		UnmapFile();
+		return false;
+	}
+	return true;
+}
+
+void util_cache::Init(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache_path = path;
+	cache_tried = false;
+}
+
+void util_cache::Close()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	if (cache_view)
+	{
+#ifdef _WIN32
+		FlushViewOfFile(cache_view, 0);
+		FlushFileBuffers(cache_file);
+#else
+		msync(cache_view, kFileSize, MS_SYNC);
+#endif
+	}
+	UnmapFile();
+	cache_tried = false;
+}
+
+bool util_cache::Find(const std::string& key, std::string& value)
+{
+	if (key.empty() || key.length() > 255) return false;
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	if (!EnsureMapped()) return false;
+
+	uint64_t hash = Fnv1a(14695981039346656037ULL, key.data(), key.length());
+	CacheSlot* slots = Slots();
+
+	for (uint32_t probe = 0; probe < kMaxProbe; ++probe)
+	{
+		const CacheSlot& slot = slots[(hash + probe) % kSlotCount];
+
+		//遇到从未写入过的空槽说明键不存在
+		if (slot.key_len == 0) return false;
+
+		//校验失败（包括写入中途崩溃、checksum仍为0）的槽位视为损坏，跳过继续探测
+		if (slot.key_len == 0 || slot.checksum == 0 || slot.checksum != SlotChecksum(slot)) continue;
+
+		if (slot.hash == static_cast<uint32_t>(hash) && slot.key_len == key.length()
+			&& memcmp(slot.data, key.data(), key.length()) == 0)
+		{
+			value.assign(slot.data + slot.key_len, slot.value_len);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void util_cache::Store(const std::string& key, const std::string& value)
+{
+	if (key.empty() || key.length() + value.length() > sizeof(CacheSlot::data) || key.length() > 255 || value.length() > 255) return;
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	if (!EnsureMapped()) return;
+
+	uint64_t hash = Fnv1a(14695981039346656037ULL, key.data(), key.length());
+	CacheSlot* slots = Slots();
+
+	//默认替换首个探测位置，若找到相同的键、空槽或损坏槽位则使用之
+	CacheSlot* target = &slots[hash % kSlotCount];
+	for (uint32_t probe = 0; probe < kMaxProbe; ++probe)
+	{
+		CacheSlot& slot = slots[(hash + probe) % kSlotCount];
+		if (slot.key_len == 0 || slot.checksum == 0 || slot.checksum != SlotChecksum(slot)
+			|| (slot.hash == static_cast<uint32_t>(hash) && slot.key_len == key.length()
+				&& memcmp(slot.data, key.data(), key.length()) == 0))
+		{
+			target = &slot;
+			break;
+		}
+	}
+
+	//先使槽位失效再写入内容，最后写入校验值
+	target->checksum = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	target->hash = static_cast<uint32_t>(hash);
+	target->key_len = static_cast<uint8_t>(key.length());
+	target->value_len = static_cast<uint8_t>(value.length());
+	memcpy(target->data, key.data(), key.length());
+	memcpy(target->data + key.length(), value.data(), value.length());
+	std::atomic_thread_fence(std::memory_order_release);
+	target->checksum = SlotChecksum(*target);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+
+/**
+** 计算结果的持久化缓存
+** 缓存文件为内存映射的开放寻址哈希表，槽位定长，重启后依旧有效
+** 所有查找与写入共用一把全局锁，多个工作线程同时访问缓存时会在这里串行
+*/
+namespace util_cache {
+	/**
+	** 记录缓存文件路径，文件在第一次访问时才会映射
+	** @param path 缓存文件路径
+	*/
+	void Init(const std::string& path);
+
+	/**
+	** 将映射内容刷写到磁盘并关闭缓存文件
+	*/
+	void Close();
+
+	/**
+	** 查找缓存
+	** @param key 键，空键总是不命中
+	** @param value 找到时写入对应的值
+	** @return 命中返回true，否则返回false
+	*/
+	bool Find(const std::string& key, std::string& value);
+
+	/**
+	** 写入缓存，空键或键值过长时直接忽略
+	** @param key 键
+	** @param value 值
+	*/
+	void Store(const std::string& key, const std::string& value);
+};
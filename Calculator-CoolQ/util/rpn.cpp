@@ -1,45 +1,76 @@
 #include "rpn.h"
+#include "bigfloat.h"
+#include "decimal.h"
+#include "modmath.h"
+#include "radix.h"
+#include "thread_pool.h"
+#include "units.h"
+#include <algorithm>
+#include <functional>
 #include <stack>
 #include <stdlib.h>
 #include <string>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
+#include <vector>
+
+//表达式长度超过此值时尝试切分后并行计算
+static const size_t kParallelThreshold = 1 << 20;
+//并行计算时每段的最小长度
+static const size_t kParallelChunk = 1 << 18;
 
-static const char* kExpressionError = "ExpressionError";
-static const char* DivisorCannotZero = "DivisorCannotZero";
 /**
-** 转换任意16位及其16位以下的进制为十进制数
-** @param str_beg 起始迭代器
-** @param str_end 结束迭代器
-** @param bit 进制（2-16）
+** 逆波兰表达式中的函数、关键字运算符与常数
+** op为其在逆波兰表达式中的操作符字符，arity为操作数个数，常数的arity为0
 */
-template <class _iter>
-static int64_t toDec(_iter str_beg, _iter str_end, int bit)
+struct NameInfo
 {
-	int64_t result = 0;
-	for (; str_beg != str_end; ++str_beg)
-	{
-		const char& ch = *str_beg;
-		result *= bit;
-		if (ch >= '0' && ch <= '9')
-		{
-			result += ch - '0';
-		}
-		else if (ch >= 'a' && ch <= 'f')
-		{
-			result += ch - 'a' + 10;
-		}
-		else if (ch >= 'A' && ch <= 'F')
-		{
-			result += ch - 'A' + 10;
-		}
-		else
-		{
-			return 0;
-		}
-	}
-	return result;
-}
+	const char* name;
+	char op;
+	int arity;
+	bool function;
+};
+
+static const NameInfo kNames[] = {
+	{ "powmod", 'P', 3, true },
+	{ "invmod", 'I', 2, true },
+	{ "sqrt", 'S', 1, true },
+	{ "exp", 'X', 1, true },
+	{ "mod", 'M', 2, false },
+	{ "ln", 'L', 1, true },
+	{ "pi", 'p', 0, false },
+	{ "e", 'n', 0, false },
+};
+
+/**
+** 计算栈中的值
+** 记录乘方运算的底数和指数，紧随其后的取模运算可以按模幂精确计算，避免乘方先溢出
+*/
+template <typename T>
+struct RpnValue
+{
+	T number;
+	bool power;
+	T base;
+	T exponent;
+
+	//值在表达式中的起始位置，用于报告缺少运算符的错误
+	size_t position;
+
+	RpnValue(const T& n = T(), size_t pos = 0) : number(n), power(false), base(), exponent(), position(pos) {}
+};
+
+/**
+** 运算符栈中的元素
+** commas记录函数调用的左括号内已出现的参数分隔符个数，用于检查函数参数个数；普通左括号为-1
+*/
+struct NotationItem
+{
+	char op;
+	size_t position;
+	int commas;
+};
 
 /**
 ** 判断字符是否是和数字有关的字符
@@ -56,278 +87,1906 @@ inline bool isNumberChar(const char& ch)
 }
 
 /**
-** 将数字缓冲区的内容转换到double数据
-** @param buf 缓冲区指针
-** @param sz 缓冲区有效数据
+** 判断字符是否为空白字符
+*/
+inline bool isSpace(const char& ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+/**
+** 根据数字缓冲区末尾的进制标记取得进制
+** 末尾的B总是视为二进制标记而不是十六进制数位，以B结尾的十六进制数需要写成H后缀或0x前缀
+** @param buf 数字缓冲区
+** @return 不带进制标记时返回10
 */
-inline double toDouble(const std::string& buf)
+inline int numberRadix(const std::string& buf)
 {
-	size_t sz = buf.length();
-	switch (buf[sz - 1])
+	switch (buf[buf.length() - 1])
 	{
 	case 'B':
-		return toDec(buf.cbegin(), buf.cend() - 1, 2);
-
+		return 2;
 	case 'O':
-		return toDec(buf.cbegin(), buf.cend() - 1, 8);
-
+		return 8;
 	case 'H':
-		return toDec(buf.cbegin(), buf.cend() - 1, 16);
-
+		return 16;
 	default:
-		return atof(buf.c_str());
+		return 10;
 	}
 }
 
 /**
-** 辅助函数，用于取两个栈顶元素
-** @return 若stack里的元素不足两个，则返回false表示获取失败*/
-template <typename T>
-inline bool RpnTop2(std::stack<T>& rpn, T& e, T& s)
+** 将数字缓冲区的内容转换到double数据
+** @param buf 数字缓冲区
+** @param value 转换结果
+** @return 数字格式错误时返回false
+*/
+inline bool toDouble(const std::string& buf, double& value)
 {
-	if (rpn.size() < 2)
+	int radix = numberRadix(buf);
+	if (radix != 10)
 	{
-		return false;
+		uint64_t integer;
+		size_t error_offset;
+		if (util_radix::Parse(buf.data(), buf.data() + buf.length() - 1, radix, integer, error_offset) != CalcErrc::kOk)
+			return false;
+		value = static_cast<double>(integer);
+		return true;
 	}
 
-	e = rpn.top();
-	rpn.pop();
-	s = rpn.top();
-	rpn.pop();
+	//整个缓冲区都必须是合法的十进制小数
+	char* end;
+	value = strtod(buf.c_str(), &end);
+	return end == buf.c_str() + buf.length();
+}
 
+/**
+** 判断数值是否为可以无损转换为64位整数的整数
+** @param value 输入值
+** @param result 转换结果
+** @return 是否可以转换
+*/
+inline bool toInt64(double value, int64_t& result)
+{
+	if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0) || floor(value) != value)
+	{
+		return false;
+	}
+	result = static_cast<int64_t>(value);
 	return true;
 }
 
 /**
-** 判断字符是否为数学操作符
-** @param ch 要判断的字符
-** @return 若为数学操作符则返回true，否则返回false
+** 在表达式中匹配一个名称，名称后紧跟字母时不视为匹配
+** 以数字字符开头的名称（如e）后紧跟数字字符时也不视为匹配，以免与十六进制数混淆
+** @param iter 当前位置
+** @param iter_end 结束位置
+** @param word 名称，为nullptr时总是不匹配
+** @return 是否匹配
 */
-inline bool isMathNotation(const char& ch)
+template <class _iter>
+static bool matchWord(_iter iter, _iter iter_end, const char* word)
 {
-	return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '%' || ch == '^';
+	if (word == nullptr) return false;
+
+	const char* name = word;
+	while (*name && iter != iter_end && *iter == *name)
+	{
+		++iter;
+		++name;
+	}
+
+	return *name == 0 && (iter == iter_end
+		|| (!isalpha(static_cast<unsigned char>(*iter)) && !(isNumberChar(*word) && isNumberChar(*iter))));
 }
 
 /**
-** 获取指定操作符优先级
-** @param ch 数学操作符字符
-** @return 优先级
+** 在表达式中匹配函数、关键字运算符或常数
+** @param iter 当前位置
+** @param iter_end 结束位置
+** @return 匹配成功返回对应信息，否则返回nullptr
 */
-inline int getMathNotationPriority(const char& ch)
+template <class _iter>
+static const NameInfo* matchName(_iter iter, _iter iter_end)
 {
-	if (ch == '(')
-		return 0;
-	if (ch == '+' || ch == '-')
-		return 1;
-	if (ch == '*' || ch == '/' || ch == '%')
-		return 2;
-	if (ch == '^')
-		return 3;
-	return -1;
+	for (const NameInfo& info : kNames)
+	{
+		if (matchWord(iter, iter_end, info.name)) return &info;
+	}
+	return nullptr;
 }
 
 /**
-** 计算逆波兰表达式
-** @param rpn_exp 逆波兰表达式串
-** @param exp_len 逆波兰表达式串的长度
-** @return 返回最终计算结果 */
-double CalculateRpn(const std::string& rpn_exp)
+** 根据逆波兰操作符查找函数信息
+** @param op 操作符字符
+** @return 找不到时返回nullptr
+*/
+static const NameInfo* findName(char op)
 {
-	std::stack<double> rpn;
-	std::string number_buf;
+	for (const NameInfo& info : kNames)
+	{
+		if (info.op == op) return &info;
+	}
+	return nullptr;
+}
+
+inline CalcErrc checkNan(double value)
+{
+	return isnan(value) ? CalcErrc::kDomainError : CalcErrc::kOk;
+}
+
+/**
+** 二进制浮点数运算，默认的计算方式
+*/
+struct DoubleArith
+{
+	typedef double Value;
+
+	bool Parse(const std::string& buf, double& value) const { return toDouble(buf, value); }
+	bool IsZero(double value) const { return value == 0; }
+	bool ToInt64(double value, int64_t& result) const { return toInt64(value, result); }
+	double FromInt64(int64_t value) const { return static_cast<double>(value); }
 
-	for (auto iter = rpn_exp.begin(); iter != rpn_exp.end(); ++iter)
+	CalcErrc Add(double s, double e, double& value) const
 	{
-		if (*iter == ' ')
-		{
-			//遇到空格，且数字缓冲区内有数据则转换转换数字缓冲区内的数据成Double类型，并入栈
-			if (!number_buf.empty())
-			{
-				rpn.push(toDouble(number_buf));
-				number_buf.clear();
-			}
-		}
-		else if (isNumberChar(*iter))
-		{
-			//加入到数字缓冲区
-			number_buf.push_back(*iter);
-		}
-		else
-		{
-			//e是stack第一次弹出的值，s是stack第二次弹出的值
-			double s, e;
-			switch (*iter)
-			{
-			case '+':
-				if (!RpnTop2(rpn, e, s))
-					throw kExpressionError;
-				rpn.push(s + e);
-				break;
+		value = s + e;
+		return checkNan(value);
+	}
 
-			case '-':
-				if (!RpnTop2(rpn, e, s))
-					throw kExpressionError;
-				rpn.push(s - e);
-				break;
+	CalcErrc Sub(double s, double e, double& value) const
+	{
+		value = s - e;
+		return checkNan(value);
+	}
 
-			case '*':
-				if (!RpnTop2(rpn, e, s))
-					throw kExpressionError;
-				rpn.push(s * e);
-				break;
+	CalcErrc Mul(double s, double e, double& value) const
+	{
+		value = s * e;
+		return checkNan(value);
+	}
 
-			case '/':
-				if (!RpnTop2(rpn, e, s) || e == 0)
-					throw DivisorCannotZero;
-				rpn.push(s / e);
-				break;
+	CalcErrc Div(double s, double e, double& value) const
+	{
+		if (e == 0)
+			return CalcErrc::kDivideByZero;
+		value = s / e;
+		return checkNan(value);
+	}
 
-			case '%':
-				if (!RpnTop2(rpn, e, s) || e == 0)
-					throw DivisorCannotZero;
-				rpn.push(static_cast<int64_t>(s) % static_cast<int64_t>(e));
-				break;
+	CalcErrc Rem(double s, double e, double& value) const
+	{
+		//%按整数取余，操作数先向零取整
+		int64_t a, modulus;
+		if (!toInt64(trunc(s), a) || !toInt64(trunc(e), modulus))
+			return CalcErrc::kDomainError;
+		if (modulus == 0)
+			return CalcErrc::kDivideByZero;
+		value = modulus == -1 ? 0 : static_cast<double>(a % modulus);
+		return CalcErrc::kOk;
+	}
 
-			case '^':
-				if (!RpnTop2(rpn, e, s))
-					throw kExpressionError;
-				rpn.push(pow(s, e));
-				break;
-			}
+	CalcErrc Mod(double s, double e, double& value) const
+	{
+		if (e == 0)
+			return CalcErrc::kDivideByZero;
+		value = s - e * floor(s / e);
+		return checkNan(value);
+	}
+
+	CalcErrc Pow(double s, double e, double& value) const
+	{
+		value = pow(s, e);
+		return checkNan(value);
+	}
+
+	CalcErrc Function(char op, double x, double& value) const
+	{
+		switch (op)
+		{
+		case 'S':
+			if (x < 0)
+				return CalcErrc::kDomainError;
+			value = sqrt(x);
+			break;
+		case 'X':
+			value = exp(x);
+			break;
+		default:
+			if (x <= 0)
+				return CalcErrc::kDomainError;
+			value = log(x);
+			break;
 		}
+		return checkNan(value);
 	}
 
-	//如果计算完毕后stack剩余的成员数不为1则失败
-	if (rpn.size() != 1)
-		throw kExpressionError;
+	CalcErrc Constant(char op, double& value) const
+	{
+		value = op == 'p' ? 3.14159265358979323846 : 2.71828182845904523536;
+		return CalcErrc::kOk;
+	}
+};
 
-	return rpn.top();
+/**
+** 以任意精度浮点数计算函数或常数
+** @param context 计算环境
+** @param op 逆波兰操作符
+** @param x 函数的参数，常数忽略此参数
+** @param value 计算结果
+** @return 错误码
+*/
+static CalcErrc bigFunction(util_big::Context& context, char op, const util_big::Float& x, util_big::Float& value)
+{
+	switch (op)
+	{
+	case 'S':
+		return context.Sqrt(x, value);
+	case 'X':
+		return context.Exp(x, value);
+	case 'L':
+		return context.Ln(x, value);
+	case 'p':
+		return context.Pi(value);
+	default:
+		return context.E(value);
+	}
 }
 
 /**
-** 辅助函数 处理新字符
-** 在将数学表达式构造为逆波兰表达式时处理新数学操作符时调用
-** @param result 结果
-** @param notation 运算符Stack
-** @param new_ch 新字符
+** 十进制浮点数运算，0.1+0.2等十进制小数的结果没有二进制误差
+** 除法与乘方的结果舍入到digits位有效数字
 */
-static void MakeRpnDisposeNewChar(std::string& result, std::stack<char>& notation, const char& new_ch)
+struct DecimalArith
 {
-	int priority = getMathNotationPriority(new_ch);
+	typedef util_decimal::Decimal Value;
 
-	while (!notation.empty())
+	int digits;
+
+	bool Parse(const std::string& buf, Value& value) const
 	{
-		//特殊情况，^操作符运算顺序是从右到左
-		if (new_ch == '^' && new_ch == notation.top()) break;
-		//如果当前顶栈运算符优先级低于新运算符优先级，则结束循环
-		if (getMathNotationPriority(notation.top()) < priority) break;
+		return util_decimal::Parse(buf.c_str(), buf.c_str() + buf.length(), value);
+	}
 
-		//顶栈运算符优先级大于新运算符优先级，根据规则，优先级高于等于的的全部出栈
-		result.push_back(notation.top());
-		result.push_back(' ');
-		notation.pop();
+	bool IsZero(const Value& value) const { return value.coefficient == 0; }
+	bool ToInt64(const Value& value, int64_t& result) const { return util_decimal::ToInt64(value, result); }
+	Value FromInt64(int64_t value) const { return util_decimal::FromInt64(value); }
+
+	CalcErrc Add(const Value& s, const Value& e, Value& value) const { return util_decimal::Add(s, e, value); }
+	CalcErrc Sub(const Value& s, const Value& e, Value& value) const { return util_decimal::Sub(s, e, value); }
+	CalcErrc Mul(const Value& s, const Value& e, Value& value) const { return util_decimal::Mul(s, e, value); }
+	CalcErrc Div(const Value& s, const Value& e, Value& value) const { return util_decimal::Div(s, e, digits, value); }
+	CalcErrc Rem(const Value& s, const Value& e, Value& value) const { return util_decimal::Rem(s, e, value); }
+	CalcErrc Mod(const Value& s, const Value& e, Value& value) const { return util_decimal::Mod(s, e, value); }
+	CalcErrc Pow(const Value& s, const Value& e, Value& value) const { return util_decimal::Pow(s, e, digits, value); }
+
+	//函数与常数以相同的精度按任意精度浮点数计算后舍入
+	CalcErrc Function(char op, const Value& x, Value& value) const
+	{
+		util_big::Context context(digits);
+		util_big::Float big;
+		CalcErrc code = bigFunction(context, op, context.FromScaled(x.coefficient, x.exponent), big);
+		if (code != CalcErrc::kOk)
+			return code;
+
+		int64_t coefficient, exponent;
+		if (!context.ToScaled(big, digits, coefficient, exponent)
+			|| exponent > util_decimal::kMaxExponent || exponent < -util_decimal::kMaxExponent)
+			return CalcErrc::kOverflow;
+
+		value.coefficient = coefficient;
+		value.exponent = static_cast<int32_t>(exponent);
+		return CalcErrc::kOk;
 	}
 
-	notation.push(new_ch);
-}
+	CalcErrc Constant(char op, Value& value) const { return Function(op, util_decimal::FromInt64(0), value); }
+};
 
 /**
-** 将一个数学表达式构造为逆波兰表达式
-** @param _math_exp 表达式串
-** @param _exp_len 表达式串的长度
-** @return 返回逆波兰表达式 */
-std::string MakeRpn(const std::string& math_exp)
+** 任意精度浮点数运算，有效数字位数与计算量上限由context决定
+*/
+struct BigArith
 {
-	bool first = true;
+	typedef util_big::Float Value;
 
-	std::stack<char> notation;
-	std::string result;
+	util_big::Context& context;
 
-	auto iter_end = math_exp.end();
-	for (auto iter = math_exp.begin(); iter != iter_end; ++iter)
+	explicit BigArith(util_big::Context& c) : context(c) {}
+
+	bool Parse(const std::string& buf, Value& value) const
 	{
-		if (*iter == ' ')
-			continue;
+		return context.Parse(buf.c_str(), buf.c_str() + buf.length(), value);
+	}
 
-		//开头第一个有效符号
-		if (first)
-		{
-			//如果开头第一个有效符号是+或者-，则在开头补一个0
-			if (*iter == '-' || *iter == '+')
-			{
-				result.push_back('0');
-				result.push_back(' ');
-			}
+	bool IsZero(const Value& value) const { return value.mantissa.empty(); }
+	bool ToInt64(const Value& value, int64_t& result) const { return context.ToInt64(value, result); }
+	Value FromInt64(int64_t value) const { return context.FromInt64(value); }
 
-			first = false;
-		}
+	CalcErrc Add(const Value& s, const Value& e, Value& value) const { return context.Add(s, e, value); }
+	CalcErrc Sub(const Value& s, const Value& e, Value& value) const { return context.Sub(s, e, value); }
+	CalcErrc Mul(const Value& s, const Value& e, Value& value) const { return context.Mul(s, e, value); }
+	CalcErrc Div(const Value& s, const Value& e, Value& value) const { return context.Div(s, e, value); }
+	CalcErrc Rem(const Value& s, const Value& e, Value& value) const { return context.Rem(s, e, value); }
+	CalcErrc Mod(const Value& s, const Value& e, Value& value) const { return context.Mod(s, e, value); }
+	CalcErrc Pow(const Value& s, const Value& e, Value& value) const { return context.Pow(s, e, value); }
+	CalcErrc Function(char op, const Value& x, Value& value) const { return bigFunction(context, op, x, value); }
+	CalcErrc Constant(char op, Value& value) const { return bigFunction(context, op, Value(), value); }
+};
 
-		//用于标识是否追加过数字，若追加过数字，则需要在完成后在末尾插入空格
-		bool flag = false;
+/**
+** 带单位的量的运算，数值按二进制浮点数以基本单位计
+** 加减与取余要求量纲相同，乘除时量纲相加减，乘方的指数与exp、ln的参数必须是无量纲的数
+*/
+struct UnitArith
+{
+	typedef util_unit::Quantity Value;
 
-		while (isNumberChar(*iter) || *iter == ' ')
-		{
-			if (*iter != ' ')
-			{
-				result.push_back(*iter);
-				flag = true;
-			}
+	static Value Number(double number)
+	{
+		Value value;
+		value.value = number;
+		value.dimension = util_unit::Dimension{};
+		return value;
+	}
 
-			if (++iter == iter_end)
-				break;
-		}
+	bool Parse(const std::string& buf, Value& value) const
+	{
+		double number;
+		if (!toDouble(buf, number))
+			return false;
+		value = Number(number);
+		return true;
+	}
 
-		if (flag) //如果追加过数字，则在结果尾部加入空格
-			result.push_back(' ');
+	bool IsZero(const Value& value) const { return value.value == 0; }
 
-		if (iter == iter_end)
-			break;
+	bool ToInt64(const Value& value, int64_t& result) const
+	{
+		return util_unit::IsDimensionless(value.dimension) && toInt64(value.value, result);
+	}
 
-		if (*iter == ')')
-		{
-			//如果遇到右括号，则不断弹出数学操作符栈中符号，直到遇到左括号或全部弹出
-			while (!notation.empty())
-			{
-				char top_ch = notation.top();
-				notation.pop();
-				//遇到左括号，退出循环
-				if (top_ch == '(')
-					break;
-				//将弹出的内容输出到结果
-				result.push_back(top_ch);
-				result.push_back(' ');
-			}
-		}
-		else if (*iter == '(')
+	Value FromInt64(int64_t value) const { return Number(static_cast<double>(value)); }
+
+	CalcErrc Add(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::SameDimension(s.dimension, e.dimension))
+			return CalcErrc::kDimensionMismatch;
+		value.dimension = s.dimension;
+		return DoubleArith().Add(s.value, e.value, value.value);
+	}
+
+	CalcErrc Sub(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::SameDimension(s.dimension, e.dimension))
+			return CalcErrc::kDimensionMismatch;
+		value.dimension = s.dimension;
+		return DoubleArith().Sub(s.value, e.value, value.value);
+	}
+
+	CalcErrc Mul(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::Combine(s.dimension, e.dimension, 1, value.dimension))
+			return CalcErrc::kOverflow;
+		return DoubleArith().Mul(s.value, e.value, value.value);
+	}
+
+	CalcErrc Div(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::Combine(s.dimension, e.dimension, -1, value.dimension))
+			return CalcErrc::kOverflow;
+		return DoubleArith().Div(s.value, e.value, value.value);
+	}
+
+	CalcErrc Rem(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::SameDimension(s.dimension, e.dimension))
+			return CalcErrc::kDimensionMismatch;
+		value.dimension = s.dimension;
+		return DoubleArith().Rem(s.value, e.value, value.value);
+	}
+
+	CalcErrc Mod(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::SameDimension(s.dimension, e.dimension))
+			return CalcErrc::kDimensionMismatch;
+		value.dimension = s.dimension;
+		return DoubleArith().Mod(s.value, e.value, value.value);
+	}
+
+	CalcErrc Pow(const Value& s, const Value& e, Value& value) const
+	{
+		if (!util_unit::IsDimensionless(e.dimension))
+			return CalcErrc::kDimensionMismatch;
+
+		//带单位的底数乘方后各量纲的指数必须仍为整数，如 (m^2)^0.5
+		value.dimension = s.dimension;
+		if (!util_unit::IsDimensionless(s.dimension) && !util_unit::Scale(s.dimension, e.value, value.dimension))
+			return CalcErrc::kDomainError;
+		return DoubleArith().Pow(s.value, e.value, value.value);
+	}
+
+	CalcErrc Function(char op, const Value& x, Value& value) const
+	{
+		value.dimension = x.dimension;
+		if (op == 'S')
 		{
-			//右括号，无条件直接加入
-			notation.push(*iter);
+			if (!util_unit::Scale(x.dimension, 0.5, value.dimension))
+				return CalcErrc::kDomainError;
 		}
-		else if (isMathNotation(*iter))
+		else if (!util_unit::IsDimensionless(x.dimension))
 		{
-			MakeRpnDisposeNewChar(result, notation, *iter);
+			return CalcErrc::kDimensionMismatch;
 		}
+		return DoubleArith().Function(op, x.value, value.value);
 	}
 
-	//处理完表达式字符串后，如果栈内还有残留数据，那么依次出栈，加入到结果
-	while (!notation.empty())
+	CalcErrc Constant(char op, Value& value) const
 	{
-		result.push_back(notation.top());
-		result.push_back(' ');
-		notation.pop();
+		value.dimension = util_unit::Dimension{};
+		return DoubleArith().Constant(op, value.value);
 	}
+};
 
-	return result;
+/**
+** 单位对应的量，只有带单位的运算方式支持单位
+** @return 不支持单位时返回false
+*/
+template <class _arith>
+inline bool unitValue(const _arith&, const util_unit::Unit&, typename _arith::Value&)
+{
+	return false;
 }
 
-double CalculateExpr(const std::string& expr)
+inline bool unitValue(const UnitArith&, const util_unit::Unit& unit, util_unit::Quantity& value)
 {
-	try
-	{
-		return CalculateRpn(MakeRpn(expr));
-	}
-	catch (const char* error_msg)
-	{
-		throw error_msg;
-	}
+	value.value = unit.scale;
+	value.dimension = unit.dimension;
+	return true;
+}
+
+/**
+** 把以摄氏度、华氏度等温度单位计的无量纲数值换算为开尔文
+** @return 错误码，不支持单位时返回kUnknownToken
+*/
+template <class _arith>
+inline CalcErrc affineValue(const _arith&, const util_unit::Unit&, typename _arith::Value&)
+{
+	return CalcErrc::kUnknownToken;
+}
+
+inline CalcErrc affineValue(const UnitArith&, const util_unit::Unit& unit, util_unit::Quantity& value)
+{
+	if (!util_unit::IsDimensionless(value.dimension))
+		return CalcErrc::kDimensionMismatch;
+	value.value = (value.value + unit.offset) * unit.scale;
+	value.dimension = unit.dimension;
+	return checkNan(value.value);
+}
+
+/**
+** 计算 s ^ e mod m，要求三者均为整数且m为正数
+** @param floor_mod 为true时结果与m同号（mod），否则与被除数同号（%）
+** @param result 计算结果
+** @return 操作数不满足条件时返回false
+*/
+template <class _arith>
+static bool powMod(const _arith& arith, const typename _arith::Value& s, const typename _arith::Value& e,
+	const typename _arith::Value& m, bool floor_mod, typename _arith::Value& result)
+{
+	int64_t base, exponent, modulus;
+	if (!arith.ToInt64(s, base) || !arith.ToInt64(e, exponent) || !arith.ToInt64(m, modulus) || exponent < 0 || modulus <= 0)
+	{
+		return false;
+	}
+
+	uint64_t magnitude = base < 0 ? 0 - static_cast<uint64_t>(base) : static_cast<uint64_t>(base);
+	uint64_t r = util_mod::PowMod(magnitude, static_cast<uint64_t>(exponent), static_cast<uint64_t>(modulus));
+
+	//负底数的奇数次幂为负数
+	if (base < 0 && (exponent & 1) && r != 0)
+	{
+		result = arith.FromInt64(floor_mod ? static_cast<int64_t>(static_cast<uint64_t>(modulus) - r) : -static_cast<int64_t>(r));
+	}
+	else
+	{
+		result = arith.FromInt64(static_cast<int64_t>(r));
+	}
+	return true;
+}
+
+/**
+** 辅助函数，用于取两个栈顶元素
+** @return 若stack里的元素不足两个，则返回false表示获取失败*/
+template <typename T>
+inline bool RpnTop2(std::stack<T>& rpn, T& e, T& s)
+{
+	if (rpn.size() < 2)
+	{
+		return false;
+	}
+
+	e = rpn.top();
+	rpn.pop();
+	s = rpn.top();
+	rpn.pop();
+
+	return true;
+}
+
+/**
+** 判断字符是否为数学操作符
+** @param ch 要判断的字符
+** @return 若为数学操作符则返回true，否则返回false
+*/
+inline bool isMathNotation(const char& ch)
+{
+	return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '%' || ch == '^';
+}
+
+/**
+** 获取指定操作符优先级
+** @param ch 数学操作符字符
+** @return 优先级
+*/
+inline int getMathNotationPriority(const char& ch)
+{
+	if (ch == '(' || ch == 'P' || ch == 'I' || ch == 'S' || ch == 'X' || ch == 'L')
+		return 0;
+	if (ch == '+' || ch == '-')
+		return 1;
+	if (ch == '*' || ch == '/' || ch == '%' || ch == 'M')
+		return 2;
+	//U为数值与紧随其后的单位之间省略的乘号，结合得比乘除紧，如 60 km/h 中的 60 km
+	if (ch == 'U')
+		return 3;
+	if (ch == '^')
+		return 4;
+	return -1;
+}
+
+/**
+** 获取逆波兰操作符的操作数个数
+** @param op 操作符
+** @return 操作数个数，常数为0
+*/
+static int getOperatorArity(char op)
+{
+	if (isMathNotation(op) || op == 'U') return 2;
+
+	const NameInfo* info = findName(op);
+	return info != nullptr ? info->arity : 0;
+}
+
+/**
+** 对计算栈应用一个逆波兰操作符，非操作符字符（如左括号）直接忽略
+** @param arith 数值运算方式
+** @param rpn 计算栈
+** @param op 操作符
+** @param position 操作符的位置，作为常数的值在表达式中的位置
+** @return 错误码
+*/
+template <class _arith>
+static CalcErrc ApplyOperator(const _arith& arith, std::stack<RpnValue<typename _arith::Value>>& rpn, char op, size_t position)
+{
+	typedef typename _arith::Value Value;
+
+	//e是stack第一次弹出的值，s是stack第二次弹出的值
+	RpnValue<Value> s, e, m;
+	Value value;
+	int64_t a, modulus;
+	CalcErrc code;
+
+	switch (op)
+	{
+	case '+':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		code = arith.Add(s.number, e.number, value);
+		break;
+
+	case '-':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		code = arith.Sub(s.number, e.number, value);
+		break;
+
+	case '*':
+	case 'U':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		code = arith.Mul(s.number, e.number, value);
+		break;
+
+	case '/':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		code = arith.Div(s.number, e.number, value);
+		break;
+
+	case '%':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		if (s.power && powMod(arith, s.base, s.exponent, e.number, false, value))
+			code = CalcErrc::kOk;
+		else
+			code = arith.Rem(s.number, e.number, value);
+		break;
+
+	case 'M':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		if (arith.IsZero(e.number))
+			return CalcErrc::kDivideByZero;
+		if (s.power && powMod(arith, s.base, s.exponent, e.number, true, value))
+			code = CalcErrc::kOk;
+		else
+			code = arith.Mod(s.number, e.number, value);
+		break;
+
+	case '^':
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		code = arith.Pow(s.number, e.number, value);
+		if (code != CalcErrc::kOk)
+			return code;
+		rpn.push(RpnValue<Value>(value, s.position));
+		rpn.top().power = true;
+		rpn.top().base = s.number;
+		rpn.top().exponent = e.number;
+		return CalcErrc::kOk;
+
+	case 'P':
+		//m为模数，e为指数，s为底数
+		if (!RpnTop2(rpn, m, e) || rpn.empty())
+			return CalcErrc::kMissingOperand;
+		s = rpn.top();
+		rpn.pop();
+		if (!powMod(arith, s.number, e.number, m.number, true, value))
+			return CalcErrc::kDomainError;
+		code = CalcErrc::kOk;
+		break;
+
+	case 'I':
+	{
+		uint64_t inverse;
+		if (!RpnTop2(rpn, e, s))
+			return CalcErrc::kMissingOperand;
+		if (!arith.ToInt64(s.number, a) || !arith.ToInt64(e.number, modulus) || modulus <= 0)
+			return CalcErrc::kDomainError;
+		//先将a规约到[0, modulus)
+		a %= modulus;
+		if (a < 0) a += modulus;
+		if (!util_mod::InvMod(static_cast<uint64_t>(a), static_cast<uint64_t>(modulus), inverse))
+			return CalcErrc::kNoModularInverse;
+		value = arith.FromInt64(static_cast<int64_t>(inverse));
+		code = CalcErrc::kOk;
+		break;
+	}
+
+	case 'S':
+	case 'X':
+	case 'L':
+		if (rpn.empty())
+			return CalcErrc::kMissingOperand;
+		s = rpn.top();
+		rpn.pop();
+		code = arith.Function(op, s.number, value);
+		break;
+
+	case 'p':
+	case 'n':
+		s.position = position;
+		code = arith.Constant(op, value);
+		break;
+
+	default:
+		return CalcErrc::kOk;
+	}
+
+	if (code != CalcErrc::kOk)
+		return code;
+
+	rpn.push(RpnValue<Value>(value, s.position));
+	return CalcErrc::kOk;
+}
+
+/**
+** 检查计算结束后的计算栈，正确的表达式应当恰好剩余一个值
+** @param rpn 计算栈
+** @return 计算结果
+*/
+template <typename T>
+static Expected<T> FinishStack(const std::stack<RpnValue<T>>& rpn)
+{
+	if (rpn.empty())
+		return CalcError{ CalcErrc::kMissingOperand, 0 };
+
+	//剩余多个值说明最后一个值之前缺少运算符
+	if (rpn.size() != 1)
+		return CalcError{ CalcErrc::kMissingOperator, rpn.top().position };
+
+	return rpn.top().number;
+}
+
+/**
+** 计算逆波兰表达式
+** @param rpn_exp 逆波兰表达式串
+** @return 返回最终计算结果，出错位置为逆波兰表达式串中的偏移 */
+Expected<double> CalculateRpn(const std::string& rpn_exp)
+{
+	DoubleArith arith;
+	std::stack<RpnValue<double>> rpn;
+	std::string number_buf;
+	size_t number_pos = 0;
+
+	for (size_t i = 0; i < rpn_exp.length(); ++i)
+	{
+		char ch = rpn_exp[i];
+		if (ch == ' ')
+		{
+			//遇到空格，且数字缓冲区内有数据则转换转换数字缓冲区内的数据成Double类型，并入栈
+			if (!number_buf.empty())
+			{
+				double value;
+				if (!toDouble(number_buf, value))
+					return CalcError{ CalcErrc::kInvalidNumber, number_pos };
+				rpn.push(RpnValue<double>(value, number_pos));
+				number_buf.clear();
+			}
+		}
+		else if (isNumberChar(ch))
+		{
+			//加入到数字缓冲区
+			if (number_buf.empty()) number_pos = i;
+			number_buf.push_back(ch);
+		}
+		else
+		{
+			CalcErrc code = ApplyOperator(arith, rpn, ch, i);
+			if (code != CalcErrc::kOk)
+				return CalcError{ code, i };
+		}
+	}
+
+	return FinishStack(rpn);
+}
+
+/**
+** 输出逆波兰表达式串的接收器，供MakeRpn使用
+*/
+struct RpnStringSink
+{
+	std::string result;
+
+	CalcErrc Number(const std::string& number, size_t)
+	{
+		double value;
+		if (!toDouble(number, value))
+			return CalcErrc::kInvalidNumber;
+
+		result += number;
+		result.push_back(' ');
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Integer(uint64_t number, size_t)
+	{
+		result += std::to_string(number);
+		result.push_back(' ');
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Operator(char op, size_t)
+	{
+		result.push_back(op);
+		result.push_back(' ');
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Variable(size_t)
+	{
+		return CalcErrc::kUnknownToken;
+	}
+
+	CalcErrc Unit(const util_unit::Unit&, size_t)
+	{
+		return CalcErrc::kUnknownToken;
+	}
+
+	CalcErrc Affine(const util_unit::Unit&)
+	{
+		return CalcErrc::kUnknownToken;
+	}
+};
+
+/**
+** 边解析边计算的接收器，操作符一旦可以归约立即计算
+** 内存占用只与括号嵌套深度有关，与表达式长度无关
+*/
+template <class _arith>
+struct EvaluateSink
+{
+	typedef typename _arith::Value Value;
+
+	const _arith& arith;
+	std::stack<RpnValue<Value>> rpn;
+
+	explicit EvaluateSink(const _arith& a) : arith(a) {}
+
+	CalcErrc Number(const std::string& number, size_t position)
+	{
+		Value value;
+		if (!arith.Parse(number, value))
+			return CalcErrc::kInvalidNumber;
+
+		rpn.push(RpnValue<Value>(value, position));
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Integer(uint64_t number, size_t position)
+	{
+		//超出有符号整数范围的值按十进制串解析，由各运算方式负责舍入
+		if (number > static_cast<uint64_t>(INT64_MAX))
+			return Number(std::to_string(number), position);
+
+		rpn.push(RpnValue<Value>(arith.FromInt64(static_cast<int64_t>(number)), position));
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Operator(char op, size_t position)
+	{
+		return ApplyOperator(arith, rpn, op, position);
+	}
+
+	CalcErrc Variable(size_t)
+	{
+		return CalcErrc::kUnknownToken;
+	}
+
+	CalcErrc Unit(const util_unit::Unit& unit, size_t position)
+	{
+		Value value;
+		if (!unitValue(arith, unit, value))
+			return CalcErrc::kUnknownToken;
+
+		rpn.push(RpnValue<Value>(value, position));
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Affine(const util_unit::Unit& unit)
+	{
+		if (rpn.empty())
+			return CalcErrc::kMissingOperand;
+
+		rpn.top().power = false;
+		return affineValue(arith, unit, rpn.top().number);
+	}
+};
+
+//编译时模拟的计算栈中的值不是乘方结果
+static const size_t kNoPower = static_cast<size_t>(-1);
+
+/**
+** 编译表达式的接收器，按逆波兰顺序记录指令
+** 编译时模拟计算栈，与计算时一样检查操作数个数
+*/
+struct ProgramSink
+{
+	//指数为常数整数且绝对值不超过此值的乘方改为连乘
+	static const int kMaxIntegerPower = 64;
+
+	Program program;
+	//模拟的计算栈，记录每个值在表达式中的起始位置
+	std::vector<size_t> positions;
+	//模拟的计算栈，值为乘方结果时记录产生它的指令下标，紧随其后的取模与CalculateExpr一样按模幂精确计算
+	std::vector<size_t> powers;
+
+	void Push(char op, double value, size_t position)
+	{
+		program.code.push_back(Program::Instruction{ op, value });
+		positions.push_back(position);
+		powers.push_back(kNoPower);
+		program.depth = std::max(program.depth, positions.size());
+	}
+
+	CalcErrc Number(const std::string& number, size_t position)
+	{
+		double value;
+		if (!toDouble(number, value))
+			return CalcErrc::kInvalidNumber;
+
+		Push('c', value, position);
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Integer(uint64_t number, size_t position)
+	{
+		Push('c', static_cast<double>(number), position);
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Operator(char op, size_t position)
+	{
+		//常数在编译时求值
+		int arity = getOperatorArity(op);
+		if (arity == 0)
+		{
+			double value;
+			DoubleArith().Constant(op, value);
+			Push('c', value, position);
+			return CalcErrc::kOk;
+		}
+
+		if (positions.size() < static_cast<size_t>(arity))
+			return CalcErrc::kMissingOperand;
+
+		//结果的位置为第一个操作数的位置
+		size_t power = powers[positions.size() - arity];
+		positions.resize(positions.size() - arity + 1);
+		powers.resize(positions.size());
+		powers.back() = kNoPower;
+
+		//取模的左操作数是乘方结果时，撤销乘方指令，把底数与指数都留在栈上，由'y'指令一起计算
+		if ((op == '%' || op == 'M') && power != kNoPower)
+		{
+			Program::Instruction& instruction = program.code[power];
+			if (instruction.op == 'w')
+				instruction.op = 'c';
+			else
+				program.code.erase(program.code.begin() + power);
+
+			//底数与指数多占一个栈位置，直到取模为止
+			++program.depth;
+			program.code.push_back(Program::Instruction{ 'y', static_cast<double>(op) });
+			return CalcErrc::kOk;
+		}
+
+		Program::Instruction& last = program.code.back();
+		if (op == '^' && last.op == 'c' && floor(last.value) == last.value && fabs(last.value) <= kMaxIntegerPower)
+		{
+			last.op = 'w';
+			powers.back() = program.code.size() - 1;
+			return CalcErrc::kOk;
+		}
+
+		program.code.push_back(Program::Instruction{ op, 0 });
+		if (op == '^') powers.back() = program.code.size() - 1;
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Variable(size_t position)
+	{
+		Push('x', 0, position);
+		return CalcErrc::kOk;
+	}
+
+	CalcErrc Unit(const util_unit::Unit&, size_t)
+	{
+		return CalcErrc::kUnknownToken;
+	}
+
+	CalcErrc Affine(const util_unit::Unit&)
+	{
+		return CalcErrc::kUnknownToken;
+	}
+};
+
+/**
+** 辅助函数 处理新字符
+** 在将数学表达式构造为逆波兰表达式时处理新数学操作符时调用
+** @param sink 结果接收器
+** @param notation 运算符Stack
+** @param new_ch 新字符
+** @param position 新字符的位置
+** @return 出错时返回错误
+*/
+template <class _sink>
+static CalcError MakeRpnDisposeNewChar(_sink& sink, std::stack<NotationItem>& notation, const char& new_ch, size_t position)
+{
+	int priority = getMathNotationPriority(new_ch);
+
+	while (!notation.empty())
+	{
+		const NotationItem& top = notation.top();
+		//特殊情况，^操作符运算顺序是从右到左
+		if (new_ch == '^' && new_ch == top.op) break;
+		//如果当前顶栈运算符优先级低于新运算符优先级，则结束循环
+		if (getMathNotationPriority(top.op) < priority) break;
+
+		//顶栈运算符优先级大于新运算符优先级，根据规则，优先级高于等于的的全部出栈
+		CalcErrc code = sink.Operator(top.op, top.position);
+		if (code != CalcErrc::kOk) return CalcError{ code, top.position };
+		notation.pop();
+	}
+
+	notation.push(NotationItem{ new_ch, position, 0 });
+	return CalcError{ CalcErrc::kOk, 0 };
+}
+
+/**
+** 判断表达式剩余部分是否只有等号和空白，如“1+1=”
+*/
+template <class _iter>
+static bool isTrailingEquals(_iter iter, _iter iter_end)
+{
+	for (; iter != iter_end; ++iter)
+	{
+		if (*iter != '=' && !isSpace(*iter)) return false;
+	}
+	return true;
+}
+
+/**
+** 整数的进制前缀0x、0b、0o中的字母对应的进制
+** @return 不是进制前缀时返回0
+*/
+inline int prefixRadix(char ch)
+{
+	switch (ch)
+	{
+	case 'x':
+		return 16;
+	case 'b':
+		return 2;
+	case 'o':
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+/**
+** 判断字符是否可以作为2-36进制的数位
+*/
+inline bool isRadixDigit(char ch)
+{
+	return isalnum(static_cast<unsigned char>(ch)) != 0;
+}
+
+/**
+** 判断从当前位置开始的数字是否以B、O、H后缀结尾
+** b同时是十六进制数字，0b1H、0bcH这样的数字是后缀写法的十六进制数，不能按0b前缀读取
+*/
+template <class _iter>
+static bool hasRadixSuffix(_iter iter, _iter iter_end)
+{
+	char last = 0;
+	for (; iter != iter_end && (isNumberChar(*iter) || isSpace(*iter)); ++iter)
+	{
+		if (!isSpace(*iter)) last = *iter;
+	}
+	return last == 'B' || last == 'O' || last == 'H';
+}
+
+/**
+** 带单位的表达式中，判断当前字符是否属于十进制数字
+** 字母都留给单位名称，只有e、E之后紧跟（可以带正负号的）数字时作为指数读取，如1.5e-3
+** @param iter 当前位置
+** @param iter_end 结束位置
+** @param number_buf 已读取的数字
+*/
+template <class _iter>
+static bool isDecimalChar(_iter iter, _iter iter_end, const std::string& number_buf)
+{
+	char ch = *iter;
+	if ((ch >= '0' && ch <= '9') || ch == '.')
+		return true;
+	if (number_buf.empty())
+		return false;
+
+	char last = number_buf[number_buf.length() - 1];
+	if (ch == '+' || ch == '-')
+		return last == 'e' || last == 'E';
+	if (ch != 'e' && ch != 'E')
+		return false;
+
+	_iter next = iter + 1;
+	if (next != iter_end && (*next == '+' || *next == '-')) ++next;
+	return next != iter_end && *next >= '0' && *next <= '9';
+}
+
+/**
+** 从当前位置读取一个数字交给接收器，不是数字时什么也不做
+** 带进制的整数可以写成0x、0b、0o前缀，“进制#数位”（进制为2-36的十进制数），或者B、O、H后缀
+** @param iter_begin 表达式起始迭代器
+** @param iter 当前位置，读取后移动到数字之后的第一个非空白字符
+** @param iter_end 表达式结束迭代器
+** @param sink 结果接收器
+** @param variable 变量名，可以为nullptr
+** @param units 是否为带单位的表达式，此时不使用后缀写法，数字之后的字母作为单位
+** @param number_buf 数字缓冲区
+** @return 出错时返回错误及其位置
+*/
+template <class _iter, class _sink>
+static CalcError readNumber(_iter iter_begin, _iter& iter, _iter iter_end, _sink& sink, const char* variable, bool units,
+	std::string& number_buf)
+{
+	size_t number_pos = static_cast<size_t>(iter - iter_begin);
+	size_t digits_pos = number_pos;
+	int radix = 0;
+	number_buf.clear();
+
+	if (iter_end - iter > 2 && iter[0] == '0' && prefixRadix(iter[1]) != 0 && isRadixDigit(iter[2])
+		&& (units || !hasRadixSuffix(iter, iter_end)))
+	{
+		radix = prefixRadix(iter[1]);
+		iter += 2;
+		digits_pos += 2;
+		while (iter != iter_end && isRadixDigit(*iter)) number_buf.push_back(*iter++);
+		while (iter != iter_end && isSpace(*iter)) ++iter;
+	}
+	else
+	{
+		//以数字字符开头的名称（如exp、e）与变量名不作为数字读取，数字之后的变量名（如2a）属于省略乘号的乘法
+		while (((units ? isDecimalChar(iter, iter_end, number_buf) : isNumberChar(*iter))
+			&& !matchWord(iter, iter_end, variable) && (!number_buf.empty() || !matchName(iter, iter_end)))
+			|| isSpace(*iter))
+		{
+			if (!isSpace(*iter))
+				number_buf.push_back(*iter);
+
+			if (++iter == iter_end)
+				break;
+		}
+
+		if (number_buf.empty())
+			return CalcError{ CalcErrc::kOk, 0 };
+
+		if (iter != iter_end && *iter == '#' && number_buf.find_first_not_of("0123456789") == std::string::npos)
+		{
+			radix = number_buf.length() <= 2 ? atoi(number_buf.c_str()) : 0;
+			if (radix < util_radix::kMinRadix || radix > util_radix::kMaxRadix)
+				return CalcError{ CalcErrc::kInvalidNumber, number_pos };
+
+			digits_pos = static_cast<size_t>(++iter - iter_begin);
+			number_buf.clear();
+			while (iter != iter_end && isRadixDigit(*iter)) number_buf.push_back(*iter++);
+			while (iter != iter_end && isSpace(*iter)) ++iter;
+		}
+		else if (numberRadix(number_buf) != 10)
+		{
+			radix = numberRadix(number_buf);
+			number_buf.pop_back();
+		}
+		else
+		{
+			CalcErrc code = sink.Number(number_buf, number_pos);
+			return CalcError{ code, code == CalcErrc::kOk ? 0 : number_pos };
+		}
+	}
+
+	uint64_t value;
+	size_t error_offset;
+	CalcErrc code = util_radix::Parse(number_buf.data(), number_buf.data() + number_buf.length(), radix, value, error_offset);
+	if (code == CalcErrc::kInvalidDigit)
+	{
+		//后缀写法的缓冲区中去掉了空白，按原表达式中的字符换算位置
+		_iter digit = iter_begin + digits_pos;
+		for (;; ++digit)
+		{
+			if (isSpace(*digit)) continue;
+			if (error_offset-- == 0) break;
+		}
+		return CalcError{ code, static_cast<size_t>(digit - iter_begin) };
+	}
+	if (code == CalcErrc::kOk)
+		code = sink.Integer(value, number_pos);
+	return CalcError{ code, code == CalcErrc::kOk ? 0 : number_pos };
+}
+
+/**
+** 调度场算法解析数学表达式，按逆波兰顺序将数字和操作符交给接收器
+** @param iter_begin 表达式起始迭代器
+** @param iter_end 表达式结束迭代器
+** @param sink 结果接收器
+** @param variable 变量名，为nullptr时表达式中不允许出现变量
+** @param units 是否为带单位的表达式，此时字母组成的单位名称紧跟在操作数之后时与之相乘，否则单独作为操作数
+** @return 出错时返回错误及其位置
+*/
+template <class _iter, class _sink>
+static CalcError ParseExpr(_iter iter_begin, _iter iter_end, _sink& sink, const char* variable = nullptr, bool units = false)
+{
+	//是否为表达式、括号或函数参数的开头
+	bool first = true;
+	//上一个符号是否为操作数（数字、常数、变量、单位或右括号）
+	bool operand = false;
+	//写在表达式末尾的温度单位，最后对整个表达式的值换算
+	util_unit::Unit affine{};
+	size_t affine_position = 0;
+
+	std::stack<NotationItem> notation;
+	std::string number_buf;
+	CalcErrc code;
+
+	for (_iter iter = iter_begin; iter != iter_end; ++iter)
+	{
+		if (isSpace(*iter))
+			continue;
+
+		//开头第一个有效符号
+		if (first)
+		{
+			//如果开头第一个有效符号是+或者-，则在开头补一个0，如 -x、(-x^2)、f(a, -b)
+			if (*iter == '-' || *iter == '+')
+			{
+				sink.Number("0", notation.empty() ? 0 : static_cast<size_t>(iter - iter_begin));
+			}
+
+			first = false;
+		}
+
+		CalcError number_error = readNumber(iter_begin, iter, iter_end, sink, variable, units, number_buf);
+		if (number_error.code != CalcErrc::kOk) return number_error;
+		if (!number_buf.empty()) operand = true;
+
+		if (iter == iter_end)
+			break;
+
+		size_t position = static_cast<size_t>(iter - iter_begin);
+		if (*iter == ')')
+		{
+			//如果遇到右括号，则不断弹出数学操作符栈中符号，直到遇到左括号
+			bool matched = false;
+			int commas = 0;
+			while (!notation.empty())
+			{
+				NotationItem top = notation.top();
+				notation.pop();
+				//遇到左括号，退出循环
+				if (top.op == '(')
+				{
+					matched = true;
+					commas = top.commas;
+					break;
+				}
+				//将弹出的内容输出到结果
+				code = sink.Operator(top.op, top.position);
+				if (code != CalcErrc::kOk) return CalcError{ code, top.position };
+			}
+
+			if (!matched)
+				return CalcError{ CalcErrc::kUnbalancedParenthesis, position };
+
+			//括号属于函数调用时，检查参数个数并将函数输出到结果
+			if (!notation.empty() && getMathNotationPriority(notation.top().op) == 0 && notation.top().op != '(')
+			{
+				NotationItem top = notation.top();
+				notation.pop();
+
+				const NameInfo* info = findName(top.op);
+				if (commas + 1 != info->arity)
+					return CalcError{ CalcErrc::kWrongArgumentCount, top.position };
+
+				code = sink.Operator(top.op, top.position);
+				if (code != CalcErrc::kOk) return CalcError{ code, top.position };
+			}
+			operand = true;
+		}
+		else if (*iter == ',')
+		{
+			//函数参数分隔符，弹出符号直到遇到左括号，左括号保留
+			while (!notation.empty() && notation.top().op != '(')
+			{
+				NotationItem top = notation.top();
+				notation.pop();
+				code = sink.Operator(top.op, top.position);
+				if (code != CalcErrc::kOk) return CalcError{ code, top.position };
+			}
+
+			//分隔符只能出现在函数调用的括号内
+			if (notation.empty() || notation.top().commas < 0)
+				return CalcError{ CalcErrc::kUnknownToken, position };
+			++notation.top().commas;
+			operand = false;
+			first = true;
+		}
+		else if (*iter == '(')
+		{
+			//左括号，无条件直接加入；紧跟在函数名之后的是函数调用的括号
+			bool call = !notation.empty() && getMathNotationPriority(notation.top().op) == 0 && notation.top().op != '(';
+			notation.push(NotationItem{ '(', position, call ? 0 : -1 });
+			operand = false;
+			first = true;
+		}
+		else if (isMathNotation(*iter))
+		{
+			CalcError error = MakeRpnDisposeNewChar(sink, notation, *iter, position);
+			if (error.code != CalcErrc::kOk) return error;
+			operand = false;
+		}
+		else if (matchWord(iter, iter_end, variable))
+		{
+			//变量紧跟在操作数之后时省略了乘号，与单位一样比乘除结合得紧，如 1/2x 为 1/(2*x)
+			if (operand)
+			{
+				CalcError error = MakeRpnDisposeNewChar(sink, notation, 'U', position);
+				if (error.code != CalcErrc::kOk) return error;
+			}
+			iter += strlen(variable) - 1;
+			code = sink.Variable(position);
+			if (code != CalcErrc::kOk) return CalcError{ code, position };
+			operand = true;
+		}
+		else if (const NameInfo* info = matchName(iter, iter_end))
+		{
+			iter += strlen(info->name) - 1;
+
+			//常数直接输出；函数直接入栈，等待右括号时输出；关键字运算符按优先级处理
+			if (info->arity == 0)
+			{
+				code = sink.Operator(info->op, position);
+				if (code != CalcErrc::kOk) return CalcError{ code, position };
+			}
+			else if (info->function)
+			{
+				//函数名之后必须紧跟左括号
+				_iter next = iter + 1;
+				while (next != iter_end && isSpace(*next)) ++next;
+				if (next == iter_end || *next != '(')
+					return CalcError{ CalcErrc::kUnknownToken, position };
+
+				notation.push(NotationItem{ info->op, position, 0 });
+			}
+			else
+			{
+				CalcError error = MakeRpnDisposeNewChar(sink, notation, info->op, position);
+				if (error.code != CalcErrc::kOk) return error;
+			}
+			operand = info->arity == 0;
+		}
+		else if (units && isalpha(static_cast<unsigned char>(*iter)))
+		{
+			//单位名称为连续的字母，复制到栈上的缓冲区中查找，不分配内存
+			char name[util_unit::kMaxNameLength];
+			size_t length = 0;
+			_iter next = iter;
+			for (; next != iter_end && isalpha(static_cast<unsigned char>(*next)); ++next)
+			{
+				if (length < util_unit::kMaxNameLength) name[length] = *next;
+				++length;
+			}
+
+			util_unit::Unit unit;
+			if (length > util_unit::kMaxNameLength || !util_unit::Lookup(name, length, unit))
+				return CalcError{ CalcErrc::kUnknownToken, position };
+			iter = next - 1;
+
+			//温度单位只能紧跟在数值之后写在表达式末尾，如 -40 F
+			if (unit.affine)
+			{
+				if (!operand || !isTrailingEquals(next, iter_end))
+					return CalcError{ CalcErrc::kAffineUnit, position };
+				affine = unit;
+				affine_position = position;
+				continue;
+			}
+
+			if (operand)
+			{
+				CalcError error = MakeRpnDisposeNewChar(sink, notation, 'U', position);
+				if (error.code != CalcErrc::kOk) return error;
+			}
+			code = sink.Unit(unit, position);
+			if (code != CalcErrc::kOk) return CalcError{ code, position };
+			operand = true;
+		}
+		else if (*iter == '=' && isTrailingEquals(iter, iter_end))
+		{
+			break;
+		}
+		else
+		{
+			return CalcError{ CalcErrc::kUnknownToken, position };
+		}
+	}
+
+	//处理完表达式字符串后，如果栈内还有残留数据，那么依次出栈，加入到结果
+	while (!notation.empty())
+	{
+		NotationItem top = notation.top();
+		notation.pop();
+
+		//残留的左括号说明括号不匹配
+		if (top.op == '(')
+			return CalcError{ CalcErrc::kUnbalancedParenthesis, top.position };
+
+		code = sink.Operator(top.op, top.position);
+		if (code != CalcErrc::kOk) return CalcError{ code, top.position };
+	}
+
+	if (affine.affine)
+	{
+		code = sink.Affine(affine);
+		if (code != CalcErrc::kOk) return CalcError{ code, affine_position };
+	}
+
+	return CalcError{ CalcErrc::kOk, 0 };
+}
+
+/**
+** 将一个数学表达式构造为逆波兰表达式
+** @param math_exp 表达式串
+** @return 返回逆波兰表达式 */
+Expected<std::string> MakeRpn(const std::string& math_exp)
+{
+	RpnStringSink sink;
+	CalcError error = ParseExpr(math_exp.begin(), math_exp.end(), sink);
+	if (error.code != CalcErrc::kOk)
+		return error;
+	return sink.result;
+}
+
+/**
+** 流式计算数学表达式，不构造完整的逆波兰表达式串
+** 与 CalculateRpn(MakeRpn(expr)) 的操作顺序完全一致，因此结果相同
+** @param arith 数值运算方式
+** @param begin 表达式起始位置
+** @param end 表达式结束位置
+** @param units 是否为带单位的表达式
+** @return 返回最终计算结果 */
+template <class _arith>
+static Expected<typename _arith::Value> EvaluateStream(const _arith& arith, const char* begin, const char* end, bool units = false)
+{
+	EvaluateSink<_arith> sink(arith);
+	CalcError error = ParseExpr(begin, end, sink, nullptr, units);
+	if (error.code != CalcErrc::kOk)
+		return error;
+
+	return FinishStack(sink.rpn);
+}
+
+/**
+** 在顶层的加减号（或全部由乘号连接时的乘号）处把超长表达式切分成若干段
+** 切分位置只取决于表达式文本，与线程数无关，保证结果可复现
+** @param expr 表达式串
+** @param cuts 写入每段的起始位置，首项为0
+** @param ops 写入全部顶层的加减号（或乘号）的位置
+** @return 表达式可以安全切分返回true
+*/
+static bool SplitAssociative(const std::string& expr, std::vector<size_t>& cuts, std::vector<size_t>& ops)
+{
+	std::vector<size_t> additive, multiplicative;
+	bool product_only = true;
+	int depth = 0;
+	char prev = 0;
+
+	for (size_t i = 0; i < expr.length(); ++i)
+	{
+		char ch = expr[i];
+		if (isSpace(ch)) continue;
+
+		if (ch == '(')
+		{
+			++depth;
+		}
+		else if (ch == ')')
+		{
+			if (--depth < 0) return false;
+		}
+		else if (depth == 0)
+		{
+			//前一个有效字符能结束一个操作数（数字、带后缀的数字、常数名如pi、右括号）时，该符号才是二元运算符
+			//误判为二元运算符时本段解析出错，会退回整体计算；误判为一元运算符则会被段内归约而丢失，所以字母一律视为操作数结尾
+			bool binary = isalnum(static_cast<unsigned char>(prev)) || prev == '.' || prev == ')';
+			if (ch == ',')
+				return false;
+			if ((ch == '+' || ch == '-') && binary)
+				additive.push_back(i);
+			else if (ch == '*' && binary)
+				multiplicative.push_back(i);
+			else if (!isNumberChar(ch) && ch != '^')
+				product_only = false;
+		}
+		prev = ch;
+	}
+
+	if (depth != 0) return false;
+
+	if (!additive.empty())
+		ops.swap(additive);
+	else if (product_only)
+		ops.swap(multiplicative);
+	else
+		return false;
+
+	cuts.assign(1, 0);
+	for (size_t pos : ops)
+	{
+		if (pos - cuts.back() >= kParallelChunk) cuts.push_back(pos);
+	}
+	return cuts.size() > 1;
+}
+
+/**
+** 切分计算时使用的接收器，段内的顶层运算不归约，只记下其右操作数
+** 各段的右操作数再由EvaluateParallel按原顺序依次归约，运算顺序与不切分时完全相同
+*/
+struct TermSink : EvaluateSink<DoubleArith>
+{
+	//本段的顶层运算符位置（在整个表达式中），本段起始位置
+	const size_t* ops;
+	size_t op_count;
+	size_t offset;
+	//已记录的右操作数
+	double* terms;
+	size_t recorded;
+
+	TermSink(const DoubleArith& a, const size_t* o, size_t count, size_t start, double* t)
+		: EvaluateSink<DoubleArith>(a), ops(o), op_count(count), offset(start), terms(t), recorded(0) {}
+
+	CalcErrc Operator(char op, size_t position)
+	{
+		if (recorded == op_count || position + offset != ops[recorded])
+			return EvaluateSink<DoubleArith>::Operator(op, position);
+
+		if (rpn.size() < 2)
+			return CalcErrc::kMissingOperand;
+		terms[recorded++] = rpn.top().number;
+		rpn.pop();
+		return CalcErrc::kOk;
+	}
+};
+
+/**
+** 将超长表达式切分后在线程池上并行计算，再按原顺序归约各段的顶层运算
+** 首段照常计算；其余各段以顶层运算符开头，记录每个顶层运算的右操作数
+** 只要有一段出错就整体重新顺序计算，保证报告的错误与不切分时相同
+** @param expr 表达式串
+** @param cuts 各段起始位置
+** @param ops 全部顶层运算符的位置
+** @return 返回最终计算结果，与顺序计算的结果逐位相同 */
+static Expected<double> EvaluateParallel(const std::string& expr, const std::vector<size_t>& cuts, const std::vector<size_t>& ops)
+{
+	size_t count = cuts.size();
+	const char* base = expr.c_str();
+	char reduce_op = expr[ops.front()] == '*' ? '*' : '+';
+
+	Expected<double> first(0.0);
+	std::vector<double> terms(ops.size());
+	//不用vector<bool>，各线程写入不同的元素不能共享同一个字节
+	std::vector<char> failed(count, false);
+	std::vector<std::function<void()>> tasks;
+	tasks.reserve(count);
+
+	tasks.emplace_back([&] {
+		first = EvaluateStream(DoubleArith(), base, base + cuts[1]);
+	});
+
+	size_t op_index = 0;
+	for (size_t i = 1; i < count; ++i)
+	{
+		while (ops[op_index] < cuts[i]) ++op_index;
+		size_t op_end = op_index;
+		while (op_end < ops.size() && (i + 1 == count || ops[op_end] < cuts[i + 1])) ++op_end;
+
+		size_t start = cuts[i];
+		const char* begin = base + start;
+		const char* end = base + (i + 1 < count ? cuts[i + 1] : expr.length());
+		tasks.emplace_back([begin, end, start, i, op_index, op_end, reduce_op, &ops, &terms, &failed] {
+			DoubleArith arith;
+			TermSink sink(arith, &ops[op_index], op_end - op_index, start, &terms[op_index]);
+			//以加减号开头的段由ParseExpr补0，以乘号开头的段补1，段内只剩这个值
+			if (reduce_op == '*') sink.rpn.push(RpnValue<double>(1, 0));
+			CalcError error = ParseExpr(begin, end, sink);
+			failed[i] = error.code != CalcErrc::kOk || sink.recorded != sink.op_count || !FinishStack(sink.rpn);
+		});
+		op_index = op_end;
+	}
+
+	util_pool::Run(tasks);
+
+	bool ok = static_cast<bool>(first);
+	for (size_t i = 1; i < count && ok; ++i) ok = !failed[i];
+
+	size_t k = 0;
+	while (ok && ops[k] < cuts[1]) ++k;
+
+	double result = ok ? first.Value() : 0;
+	for (; ok && k < ops.size(); ++k)
+	{
+		char op = expr[ops[k]];
+		CalcErrc code = op == '+' ? DoubleArith().Add(result, terms[k], result)
+			: op == '-' ? DoubleArith().Sub(result, terms[k], result)
+			: DoubleArith().Mul(result, terms[k], result);
+		ok = code == CalcErrc::kOk;
+	}
+
+	if (!ok)
+		return EvaluateStream(DoubleArith(), base, base + expr.length());
+	return result;
+}
+
+Expected<double> CalculateExpr(const std::string& expr)
+{
+	//只有超长表达式才尝试切分，普通表达式只多一次长度比较
+	std::vector<size_t> cuts, ops;
+	if (expr.length() >= kParallelThreshold && SplitAssociative(expr, cuts, ops))
+		return EvaluateParallel(expr, cuts, ops);
+
+	return EvaluateStream(DoubleArith(), expr.c_str(), expr.c_str() + expr.length());
+}
+
+Expected<util_decimal::Decimal> CalculateDecimal(const std::string& expr, int digits)
+{
+	//十进制运算的舍入与运算顺序有关，不做切分并行计算
+	DecimalArith arith;
+	arith.digits = digits;
+	return EvaluateStream(arith, expr.c_str(), expr.c_str() + expr.length());
+}
+
+Expected<util_big::Float> CalculateBig(const std::string& expr, int digits)
+{
+	util_big::Context context(digits);
+	BigArith arith(context);
+	return EvaluateStream(arith, expr.c_str(), expr.c_str() + expr.length());
+}
+
+Expected<double> ConvertUnits(const std::string& expr, const std::string& target, size_t target_offset)
+{
+	Expected<util_unit::Quantity> value = EvaluateStream(UnitArith(), expr.c_str(), expr.c_str() + expr.length(), true);
+	if (!value)
+		return value.Error();
+
+	//目标单位单独是温度单位时按温度值换算，否则与表达式一样计算
+	util_unit::Quantity unit;
+	util_unit::Unit affine;
+	double offset = 0;
+	if (util_unit::Lookup(target.c_str(), target.length(), affine) && affine.affine)
+	{
+		unit.value = affine.scale;
+		unit.dimension = affine.dimension;
+		offset = affine.offset;
+	}
+	else
+	{
+		Expected<util_unit::Quantity> parsed = EvaluateStream(UnitArith(), target.c_str(), target.c_str() + target.length(), true);
+		if (!parsed)
+			return CalcError{ parsed.Error().code, parsed.Error().position + target_offset };
+		unit = parsed.Value();
+	}
+
+	if (!util_unit::SameDimension(value.Value().dimension, unit.dimension))
+		return CalcError{ CalcErrc::kDimensionMismatch, target_offset };
+	if (unit.value == 0)
+		return CalcError{ CalcErrc::kDivideByZero, target_offset };
+
+	double converted = value.Value().value / unit.value;
+	if (offset == 0 || converted == 0)
+		return converted - offset;
+
+	//减去温度零点时有效数字相消，按减法前数值的13位有效数字舍入，去掉换算中的舍入误差，如 0 C -> F
+	double scale = pow(10.0, 12 - floor(log10(fabs(converted))));
+	return round((converted - offset) * scale) / scale;
+}
+
+bool IsValidVariable(const std::string& variable)
+{
+	if (variable.empty() || matchName(variable.begin(), variable.end()) != nullptr)
+		return false;
+
+	for (char ch : variable)
+	{
+		if (!isalpha(static_cast<unsigned char>(ch))) return false;
+	}
+	return true;
+}
+
+Expected<Program> CompileExpr(const std::string& expr, const std::string& variable)
+{
+	if (!IsValidVariable(variable))
+		return CalcError{ CalcErrc::kUnknownToken, 0 };
+
+	ProgramSink sink;
+	CalcError error = ParseExpr(expr.begin(), expr.end(), sink, variable.c_str());
+	if (error.code != CalcErrc::kOk)
+		return error;
+
+	if (sink.positions.empty())
+		return CalcError{ CalcErrc::kMissingOperand, 0 };
+	if (sink.positions.size() != 1)
+		return CalcError{ CalcErrc::kMissingOperator, sink.positions.back() };
+	return sink.program;
+}
+
+/**
+** 逐点计算没有批量实现的操作符，复用与CalculateExpr相同的运算规则
+** @param op 操作符
+** @param arity 操作数个数
+** @param operands 第一个操作数所在的栈位置，之后每个操作数相隔kProgramBatch
+** @param count 点数
+*/
+static void evaluateScalar(char op, int arity, double* operands, size_t count)
+{
+	DoubleArith arith;
+	std::stack<RpnValue<double>> rpn;
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (int k = 0; k < arity; ++k) rpn.push(RpnValue<double>(operands[k * kProgramBatch + i]));
+
+		CalcErrc code = ApplyOperator(arith, rpn, op, 0);
+		operands[i] = code == CalcErrc::kOk ? rpn.top().number : NAN;
+		while (!rpn.empty()) rpn.pop();
+	}
+}
+
+/**
+** 逐点计算乘方紧接取模，与CalculateExpr一样，底数、指数、模数都是整数时按模幂精确计算
+** @param op 取模运算符，'%'或'M'
+** @param operands 底数所在的栈位置，之后依次为指数、模数，每个操作数相隔kProgramBatch
+** @param count 点数
+*/
+static void evaluatePowerRemainder(char op, double* operands, size_t count)
+{
+	DoubleArith arith;
+	std::stack<RpnValue<double>> rpn;
+	for (size_t i = 0; i < count; ++i)
+	{
+		rpn.push(RpnValue<double>(operands[i]));
+		rpn.push(RpnValue<double>(operands[kProgramBatch + i]));
+		CalcErrc code = ApplyOperator(arith, rpn, '^', 0);
+		if (code == CalcErrc::kOk)
+		{
+			rpn.push(RpnValue<double>(operands[2 * kProgramBatch + i]));
+			code = ApplyOperator(arith, rpn, op, 0);
+		}
+		operands[i] = code == CalcErrc::kOk ? rpn.top().number : NAN;
+		while (!rpn.empty()) rpn.pop();
+	}
+}
+
+/**
+** 对一批数据求常数整数次幂，按指数的二进制位连乘
+** @param s 底数，写入结果
+** @param exponent 指数
+** @param count 点数
+*/
+static void integerPower(double* s, int exponent, size_t count)
+{
+	double base[kProgramBatch];
+	for (size_t i = 0; i < count; ++i)
+	{
+		base[i] = s[i];
+		s[i] = 1;
+	}
+
+	for (int k = exponent < 0 ? -exponent : exponent; k != 0; k >>= 1)
+	{
+		if (k & 1)
+		{
+			for (size_t i = 0; i < count; ++i) s[i] *= base[i];
+		}
+		for (size_t i = 0; i < count; ++i) base[i] *= base[i];
+	}
+
+	if (exponent < 0)
+	{
+		for (size_t i = 0; i < count; ++i) s[i] = 1 / s[i];
+	}
+}
+
+void EvaluateProgram(const Program& program, const double* x, double* y, size_t n, std::vector<double>& stack)
+{
+	stack.resize(program.depth * kProgramBatch);
+
+	for (size_t begin = 0; begin < n; begin += kProgramBatch)
+	{
+		size_t count = std::min(kProgramBatch, n - begin);
+		const double* xs = x + begin;
+		size_t top = 0;
+
+		//每条指令对整批数据循环一次，简单的循环可以由编译器自动向量化
+		for (const Program::Instruction& instruction : program.code)
+		{
+			char op = instruction.op;
+			if (op == 'c' || op == 'x')
+			{
+				double* r = &stack[top++ * kProgramBatch];
+				if (op == 'c')
+				{
+					double value = instruction.value;
+					for (size_t i = 0; i < count; ++i) r[i] = value;
+				}
+				else
+				{
+					for (size_t i = 0; i < count; ++i) r[i] = xs[i];
+				}
+				continue;
+			}
+
+			int arity = op == 'w' ? 1 : op == 'y' ? 3 : getOperatorArity(op);
+			top -= arity;
+			double* s = &stack[top * kProgramBatch];
+			const double* e = s + kProgramBatch;
+			++top;
+
+			switch (op)
+			{
+			case '+':
+				for (size_t i = 0; i < count; ++i) s[i] += e[i];
+				break;
+			case '-':
+				for (size_t i = 0; i < count; ++i) s[i] -= e[i];
+				break;
+			case '*':
+			case 'U':
+				for (size_t i = 0; i < count; ++i) s[i] *= e[i];
+				break;
+			case '/':
+				for (size_t i = 0; i < count; ++i) s[i] = e[i] == 0 ? NAN : s[i] / e[i];
+				break;
+			case '^':
+				for (size_t i = 0; i < count; ++i) s[i] = pow(s[i], e[i]);
+				break;
+			case 'w':
+				integerPower(s, static_cast<int>(instruction.value), count);
+				break;
+			case 'y':
+				evaluatePowerRemainder(static_cast<char>(instruction.value), s, count);
+				break;
+			case 'S':
+				for (size_t i = 0; i < count; ++i) s[i] = sqrt(s[i]);
+				break;
+			case 'X':
+				for (size_t i = 0; i < count; ++i) s[i] = exp(s[i]);
+				break;
+			case 'L':
+				for (size_t i = 0; i < count; ++i) s[i] = s[i] > 0 ? log(s[i]) : NAN;
+				break;
+			default:
+				evaluateScalar(op, arity, s, count);
+				break;
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i) y[begin + i] = stack[i];
+	}
+}
+
+bool MatchCall(const std::string& expr, const char* name, CallExpr& call)
+{
+	size_t length = expr.length();
+	size_t i = 0;
+	while (i < length && isSpace(expr[i])) ++i;
+	if (!matchWord(expr.begin() + i, expr.end(), name))
+		return false;
+
+	call.position = i;
+	i += strlen(name);
+	while (i < length && isSpace(expr[i])) ++i;
+	if (i == length || expr[i] != '(')
+		return false;
+
+	//调用的右括号之后只允许出现空白和等号
+	size_t end = length;
+	while (end > i && (isSpace(expr[end - 1]) || expr[end - 1] == '=')) --end;
+	if (end - 1 <= i || expr[end - 1] != ')')
+		return false;
+
+	call.args.clear();
+	call.offsets.clear();
+	int depth = 0;
+	size_t start = i + 1;
+	for (size_t k = i + 1; k < end - 1; ++k)
+	{
+		if (expr[k] == '(')
+		{
+			++depth;
+		}
+		else if (expr[k] == ')')
+		{
+			//左括号在末尾之前已经闭合，说明整个表达式不是一次调用
+			if (--depth < 0) return false;
+		}
+		else if (expr[k] == ',' && depth == 0)
+		{
+			call.args.push_back(expr.substr(start, k - start));
+			call.offsets.push_back(start);
+			start = k + 1;
+		}
+	}
+	if (depth != 0)
+		return false;
+
+	call.args.push_back(expr.substr(start, end - 1 - start));
+	call.offsets.push_back(start);
+	return true;
 }
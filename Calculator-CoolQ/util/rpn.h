@@ -1,5 +1,103 @@
-#pragma one
+#pragma once
+#include "bigfloat.h"
+#include "decimal.h"
+#include "expected.h"
+#include <stdint.h>
 #include <string>
+#include <vector>
 
-double CalculateExpr(const std::string& _expr);
+//计算引擎版本，引擎行为变化时递增，使持久化缓存中的旧结果失效
+constexpr uint32_t kEngineVersion = 7;
 
+Expected<double> CalculateExpr(const std::string& _expr);
+
+/**
+** 以十进制浮点数计算数学表达式
+** @param _expr 表达式串
+** @param digits 除法与乘方结果的有效数字位数（1-18）
+** @return 返回最终计算结果 */
+Expected<util_decimal::Decimal> CalculateDecimal(const std::string& _expr, int digits);
+
+/**
+** 以任意精度浮点数计算数学表达式
+** @param _expr 表达式串
+** @param digits 有效数字位数（1-util_big::kMaxDigits）
+** @return 返回最终计算结果，计算量超过上限时返回kBudgetExceeded */
+Expected<util_big::Float> CalculateBig(const std::string& _expr, int digits);
+
+/**
+** 计算带单位的数学表达式并换算为目标单位，如 5km -> mi、100F -> C、1GiB -> MB
+** 单位紧跟在操作数之后时与之相乘，结合得比乘除紧、比乘方松，如 60 km/h、1 kg m/s^2
+** 摄氏度、华氏度等温度单位只能写在表达式末尾，或者单独作为目标单位
+** @param _expr 表达式串
+** @param target 目标单位，可以是 km/h、m^2 这样的表达式
+** @param target_offset 目标单位相对表达式开头的偏移，目标单位中的出错位置以此换算
+** @return 返回以目标单位计的结果，量纲不一致时返回kDimensionMismatch */
+Expected<double> ConvertUnits(const std::string& _expr, const std::string& target, size_t target_offset);
+
+/**
+** 编译后的表达式，按逆波兰顺序记录常数、变量与操作符
+** 用于对同一表达式在变量的大量取值上反复求值，如求根与数值积分
+*/
+struct Program
+{
+	struct Instruction
+	{
+		//'c'为常数，'x'为变量，'w'为value次幂（整数），'y'为乘方紧接取模（value为'%'或'M'，操作数为底数、指数、模数），其余与逆波兰表达式中的操作符相同
+		char op;
+		double value;
+	};
+
+	std::vector<Instruction> code;
+	//求值所需的栈深度
+	size_t depth;
+
+	Program() : depth(0) {}
+};
+
+//批量求值时每批的点数
+constexpr size_t kProgramBatch = 256;
+
+/**
+** 判断变量名是否合法，变量名只能由字母组成且不能与函数名、常数名相同
+*/
+bool IsValidVariable(const std::string& variable);
+
+/**
+** 将带一个变量的数学表达式编译为Program
+** 变量紧跟在操作数之后时省略乘号，如 2x^2 即 2*x^2、1/2x 即 1/(2*x)
+** @param _expr 表达式串
+** @param variable 变量名
+** @return 返回编译结果，变量名不合法时返回kUnknownToken */
+Expected<Program> CompileExpr(const std::string& _expr, const std::string& variable);
+
+/**
+** 对变量的n个取值批量求值，按kProgramBatch个点一批，每条指令对整批数据做一次循环
+** 出错的点（除数为0、超出定义域等）结果为NaN
+** @param program 编译后的表达式
+** @param x 变量的取值
+** @param y 写入求值结果
+** @param n 点数
+** @param stack 求值栈的存储空间，可以在多次调用间复用
+*/
+void EvaluateProgram(const Program& program, const double* x, double* y, size_t n, std::vector<double>& stack);
+
+/**
+** 形如 name(参数, ...) 的调用
+** position为名称的位置，offsets为各参数在表达式中的起始位置
+*/
+struct CallExpr
+{
+	size_t position;
+	std::vector<std::string> args;
+	std::vector<size_t> offsets;
+};
+
+/**
+** 判断整个表达式是否为对name的一次调用，并按括号外的逗号切分参数
+** @param _expr 表达式串
+** @param name 函数名
+** @param call 写入切分结果
+** @return 是对name的调用时返回true
+*/
+bool MatchCall(const std::string& _expr, const char* name, CallExpr& call);
@@ -0,0 +1,207 @@
+#include "solve.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using util_solve::Roots;
+
+//求得的根处函数值与小区间端点处函数值之比的上限，超过时视为间断点而不是根
+static const double kResidualRatio = 1e-3;
+
+/**
+** 记录计算量的求值器
+*/
+class Evaluator
+{
+public:
+	explicit Evaluator(const Program& program) : program_(program), work_(0) {}
+
+	bool Exhausted() const { return work_ > util_solve::kWorkBudget; }
+
+	void Evaluate(const double* x, double* y, size_t n)
+	{
+		work_ += static_cast<uint64_t>(n) * program_.code.size();
+		EvaluateProgram(program_, x, y, n, stack_);
+	}
+
+	double Evaluate(double x)
+	{
+		double y;
+		Evaluate(&x, &y, 1);
+		return y;
+	}
+
+private:
+	const Program& program_;
+	std::vector<double> stack_;
+	uint64_t work_;
+};
+
+/**
+** Brent方法在[a, b]内求根，要求f(a)与f(b)异号
+** 在反二次插值、割线法与二分法之间切换，保证收敛的同时通常有超线性的收敛速度
+** @param f 求值器
+** @param a 区间端点
+** @param b 区间端点
+** @param fa f(a)
+** @param fb f(b)
+** @param tolerance 绝对误差下限
+** @param value 写入根处的函数值
+** @return 根
+*/
+static double Brent(Evaluator& f, double a, double b, double fa, double fb, double tolerance, double& value)
+{
+	double c = a, fc = fa;
+	double d = b - a, e = d;
+
+	for (;;)
+	{
+		//保持b为目前最好的近似值，c与b异号
+		if (fabs(fc) < fabs(fb))
+		{
+			a = b;
+			b = c;
+			c = a;
+			fa = fb;
+			fb = fc;
+			fc = fa;
+		}
+
+		double tol = 2 * DBL_EPSILON * fabs(b) + tolerance;
+		double m = 0.5 * (c - b);
+		if (fabs(m) <= tol || fb == 0 || f.Exhausted())
+			break;
+
+		if (fabs(e) < tol || fabs(fa) <= fabs(fb))
+		{
+			//上一步收敛太慢，改用二分
+			d = m;
+			e = m;
+		}
+		else
+		{
+			double s = fb / fa, p, q;
+			if (a == c)
+			{
+				//割线法
+				p = 2 * m * s;
+				q = 1 - s;
+			}
+			else
+			{
+				//反二次插值
+				double r = fb / fc;
+				q = fa / fc;
+				p = s * (2 * m * q * (q - r) - (b - a) * (r - 1));
+				q = (q - 1) * (r - 1) * (s - 1);
+			}
+
+			if (p > 0)
+				q = -q;
+			else
+				p = -p;
+
+			//插值点必须落在区间内，且步长要比上上步的一半小，否则二分
+			s = e;
+			e = d;
+			if (2 * p < 3 * m * q - fabs(tol * q) && p < fabs(0.5 * s * q))
+			{
+				d = p / q;
+			}
+			else
+			{
+				d = m;
+				e = m;
+			}
+		}
+
+		a = b;
+		fa = fb;
+		if (fabs(d) > tol)
+			b += d;
+		else
+			b += m > 0 ? tol : -tol;
+		fb = f.Evaluate(b);
+
+		if ((fb > 0) == (fc > 0))
+		{
+			c = a;
+			fc = fa;
+			d = b - a;
+			e = d;
+		}
+	}
+
+	value = fb;
+	return b;
+}
+
+Expected<Roots> util_solve::Solve(const Program& program, double a, double b)
+{
+	if (!isfinite(a) || !isfinite(b))
+		return CalcError{ CalcErrc::kDomainError, 0 };
+	if (a > b)
+		std::swap(a, b);
+
+	//网格求值的计算量固定，超出上限时直接失败，不做任何求值
+	if (static_cast<uint64_t>(kGridIntervals + 1) * program.code.size() > kWorkBudget)
+		return CalcError{ CalcErrc::kBudgetExceeded, 0 };
+
+	//整个网格一次批量求值
+	Evaluator f(program);
+	std::vector<double> x(kGridIntervals + 1), y(kGridIntervals + 1);
+	//区间宽度超出double范围时（如[-1e308, 1e308]）改用两端点的加权平均，两项都不会溢出
+	bool wide = !isfinite(b - a);
+	for (size_t i = 0; i < kGridIntervals; ++i)
+	{
+		double t = static_cast<double>(i) / kGridIntervals;
+		x[i] = wide ? a * (1 - t) + b * t : a + (b - a) * i / kGridIntervals;
+	}
+	x[kGridIntervals] = b;
+	f.Evaluate(x.data(), y.data(), x.size());
+
+	Roots roots;
+	roots.incomplete = false;
+	double tolerance = DBL_EPSILON * std::max(fabs(a), fabs(b));
+
+	for (size_t i = 0; i <= kGridIntervals; ++i)
+	{
+		double root = x[i];
+		if (y[i] != 0)
+		{
+			if (i == kGridIntervals || !((y[i] < 0 && y[i + 1] > 0) || (y[i] > 0 && y[i + 1] < 0)))
+				continue;
+
+			if (f.Exhausted())
+			{
+				roots.incomplete = true;
+				break;
+			}
+
+			double value;
+			root = Brent(f, x[i], x[i + 1], y[i], y[i + 1], tolerance, value);
+
+			//计算量在迭代中途用尽时Brent返回的不是收敛的根
+			if (f.Exhausted())
+			{
+				roots.incomplete = true;
+				break;
+			}
+
+			//函数在极点或跳跃间断点两侧也会变号，真正的根处函数值远小于小区间端点处的函数值
+			if (!(fabs(value) <= kResidualRatio * std::max(fabs(y[i]), fabs(y[i + 1]))))
+				continue;
+		}
+
+		if (!roots.values.empty() && roots.values.back() == root)
+			continue;
+		if (roots.values.size() == kMaxRoots)
+		{
+			roots.incomplete = true;
+			break;
+		}
+		roots.values.push_back(root);
+	}
+
+	return roots;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "expected.h"
+#include "rpn.h"
+#include <stdint.h>
+#include <vector>
+
+/**
+** 一元方程数值求根
+** 先在区间的均匀网格上批量求值，找出所有函数值变号的小区间，再用Brent方法在每个小区间内求根
+** 只能找到使函数变号的根，偶数重根（如x^2=0）与间距小于网格宽度的成对根可能找不到
+*/
+namespace util_solve {
+	//扫描网格的小区间个数
+	constexpr size_t kGridIntervals = 4096;
+	//单次求根允许的计算量（求值点数乘以指令条数）
+	constexpr uint64_t kWorkBudget = 50000000;
+	//最多返回的根的个数
+	constexpr size_t kMaxRoots = 64;
+
+	struct Roots
+	{
+		//从小到大排列
+		std::vector<double> values;
+		//计算量用尽或根的个数超过上限，区间内可能还有未列出的根
+		bool incomplete;
+	};
+
+	/**
+	** 求表达式在[a, b]内的所有根
+	** @param program 编译后的表达式
+	** @param a 区间端点
+	** @param b 区间端点，可以小于a
+	** @return 区间端点不是有限数时返回kDomainError，表达式过长使网格求值超出计算量上限时返回kBudgetExceeded
+	*/
+	Expected<Roots> Solve(const Program& program, double a, double b);
+};
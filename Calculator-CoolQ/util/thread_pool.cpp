@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//线程数上限（包括调用线程）
+static const size_t kMaxConcurrency = 16;
+
+/**
+** 一次Run调用中的全部任务共享的完成计数
+*/
+struct Batch
+{
+	std::atomic<size_t> remaining;
+	std::mutex mutex;
+	std::condition_variable done;
+};
+
+struct Task
+{
+	std::function<void()>* function;
+	Batch* batch;
+};
+
+struct WorkQueue
+{
+	std::mutex mutex;
+	std::deque<Task> tasks;
+};
+
+static std::mutex pool_mutex;
+static std::vector<std::thread> workers;
+//下标0的队列属于调用线程，其余依次属于工作线程
+static std::vector<std::unique_ptr<WorkQueue>> queues;
+static std::atomic<size_t> pending(0);
+static std::atomic<bool> stopping(false);
+static std::mutex wake_mutex;
+static std::condition_variable wake;
+
+/**
+** 从自己的队列队尾取任务，失败后依次从其他队列队首窃取
+** @param self 自己的队列下标
+** @param task 取到的任务
+** @return 取到任务返回true
+*/
+static bool TakeTask(size_t self, Task& task)
+{
+	size_t count = queues.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		WorkQueue& queue = *queues[(self + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) continue;
+
+		if (i == 0)
+		{
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+		}
+		else
+		{
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+		}
+		--pending;
+		return true;
+	}
+	return false;
+}
+
+static void Execute(const Task& task)
+{
+	(*task.function)();
+
+	//在锁内递减计数，保证Run返回（Batch析构）前不再有线程访问它
+	std::lock_guard<std::mutex> lock(task.batch->mutex);
+	if (--task.batch->remaining == 0) task.batch->done.notify_all();
+}
+
+static void WorkerMain(size_t self)
+{
+	Task task;
+	while (true)
+	{
+		if (TakeTask(self, task))
+		{
+			Execute(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex);
+		wake.wait(lock, [] { return pending > 0 || stopping; });
+		if (stopping) return;
+	}
+}
+
+/**
+** 创建工作线程，调用者需持有pool_mutex
+*/
+static void StartWorkers()
+{
+	if (!queues.empty()) return;
+
+	size_t concurrency = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), kMaxConcurrency));
+	stopping = false;
+	for (size_t i = 0; i < concurrency; ++i) queues.emplace_back(new WorkQueue());
+	for (size_t i = 1; i < concurrency; ++i) workers.emplace_back(WorkerMain, i);
+}
+
+void util_pool::Run(std::vector<std::function<void()>>& tasks)
+{
+	if (tasks.empty()) return;
+
+	//pool_mutex只保护线程池的创建与回收，多个线程可以同时调用Run
+	//调用线程都使用下标0的队列，取到的可能是其他调用者的任务，完成计数按Batch各自统计
+	{
+		std::lock_guard<std::mutex> run_lock(pool_mutex);
+		StartWorkers();
+	}
+
+	Batch batch;
+	batch.remaining = tasks.size();
+
+	size_t count = queues.size();
+	for (size_t i = 0; i < tasks.size(); ++i)
+	{
+		WorkQueue& queue = *queues[i % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(Task{ &tasks[i], &batch });
+		++pending;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		wake.notify_all();
+	}
+
+	//调用线程同样参与执行，直到没有可取的任务
+	Task task;
+	while (TakeTask(0, task)) Execute(task);
+
+	std::unique_lock<std::mutex> lock(batch.mutex);
+	batch.done.wait(lock, [&batch] { return batch.remaining == 0; });
+}
+
+size_t util_pool::Concurrency()
+{
+	std::lock_guard<std::mutex> run_lock(pool_mutex);
+	StartWorkers();
+	return queues.size();
+}
+
+void util_pool::Shutdown()
+{
+	std::lock_guard<std::mutex> run_lock(pool_mutex);
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		stopping = true;
+		wake.notify_all();
+	}
+
+	for (std::thread& worker : workers) worker.join();
+	workers.clear();
+	queues.clear();
+}
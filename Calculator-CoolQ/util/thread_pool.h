@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+#include <stddef.h>
+#include <vector>
+
+/**
+** 工作窃取线程池
+** 每个工作线程拥有自己的任务队列，从队尾取任务，空闲时从其他队列的队首窃取
+*/
+namespace util_pool {
+	/**
+	** 并行执行一组任务，调用线程同样参与执行，全部完成后返回
+	** 任务不能抛出异常；线程池在第一次调用时创建；可以在多个线程中同时调用
+	** @param tasks 任务列表
+	*/
+	void Run(std::vector<std::function<void()>>& tasks);
+
+	/**
+	** 参与计算的线程数（包括调用线程）
+	*/
+	size_t Concurrency();
+
+	/**
+	** 停止并回收全部工作线程，应在卸载前、没有正在执行的Run时调用
+	*/
+	void Shutdown();
+};
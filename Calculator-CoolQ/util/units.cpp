@@ -0,0 +1,270 @@
+#include "units.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+using util_unit::Dimension;
+using util_unit::Unit;
+
+//可以带国际单位制词头、可以带二进制词头
+static const uint8_t kPrefixable = 1;
+static const uint8_t kBinaryPrefixable = 2;
+
+struct UnitInfo
+{
+	const char* name;
+	double scale;
+	double offset;
+	Dimension dimension;
+	uint8_t flags;
+};
+
+/**
+** 按长度、质量、时间、电流、温度、物质的量、发光强度、信息量的顺序构造量纲
+*/
+constexpr Dimension dimension(int length, int mass = 0, int time = 0, int current = 0, int temperature = 0,
+	int amount = 0, int luminous = 0, int information = 0)
+{
+	return Dimension{ { static_cast<int8_t>(length), static_cast<int8_t>(mass), static_cast<int8_t>(time),
+		static_cast<int8_t>(current), static_cast<int8_t>(temperature), static_cast<int8_t>(amount),
+		static_cast<int8_t>(luminous), static_cast<int8_t>(information) } };
+}
+
+//常用的导出量纲
+static constexpr Dimension kLength = dimension(1);
+static constexpr Dimension kMass = dimension(0, 1);
+static constexpr Dimension kTime = dimension(0, 0, 1);
+static constexpr Dimension kTemperature = dimension(0, 0, 0, 0, 1);
+static constexpr Dimension kInformation = dimension(0, 0, 0, 0, 0, 0, 0, 1);
+static constexpr Dimension kArea = dimension(2);
+static constexpr Dimension kVolume = dimension(3);
+static constexpr Dimension kSpeed = dimension(1, 0, -1);
+static constexpr Dimension kForce = dimension(1, 1, -2);
+static constexpr Dimension kPressure = dimension(-1, 1, -2);
+static constexpr Dimension kEnergy = dimension(2, 1, -2);
+static constexpr Dimension kPower = dimension(2, 1, -3);
+
+//质量的基本单位为千克，温度的基本单位为开尔文，信息量的基本单位为比特
+static constexpr UnitInfo kUnits[] = {
+	{ "m", 1, 0, kLength, kPrefixable },
+	{ "in", 0.0254, 0, kLength, 0 },
+	{ "ft", 0.3048, 0, kLength, 0 },
+	{ "yd", 0.9144, 0, kLength, 0 },
+	{ "mi", 1609.344, 0, kLength, 0 },
+	{ "nmi", 1852, 0, kLength, 0 },
+	{ "au", 149597870700.0, 0, kLength, 0 },
+	{ "ly", 9460730472580800.0, 0, kLength, 0 },
+	{ "pc", 3.0856775814913673e16, 0, kLength, 0 },
+	{ "g", 1e-3, 0, kMass, kPrefixable },
+	{ "t", 1000, 0, kMass, kPrefixable },
+	{ "lb", 0.45359237, 0, kMass, 0 },
+	{ "oz", 0.028349523125, 0, kMass, 0 },
+	{ "s", 1, 0, kTime, kPrefixable },
+	{ "min", 60, 0, kTime, 0 },
+	{ "h", 3600, 0, kTime, 0 },
+	{ "d", 86400, 0, kTime, 0 },
+	{ "wk", 604800, 0, kTime, 0 },
+	{ "yr", 31557600, 0, kTime, 0 },
+	{ "A", 1, 0, dimension(0, 0, 0, 1), kPrefixable },
+	{ "K", 1, 0, kTemperature, kPrefixable },
+	{ "R", 5.0 / 9.0, 0, kTemperature, 0 },
+	{ "C", 1, 273.15, kTemperature, 0 },
+	{ "degC", 1, 273.15, kTemperature, 0 },
+	{ "F", 5.0 / 9.0, 459.67, kTemperature, 0 },
+	{ "degF", 5.0 / 9.0, 459.67, kTemperature, 0 },
+	{ "mol", 1, 0, dimension(0, 0, 0, 0, 0, 1), kPrefixable },
+	{ "cd", 1, 0, dimension(0, 0, 0, 0, 0, 0, 1), kPrefixable },
+	{ "bit", 1, 0, kInformation, kPrefixable | kBinaryPrefixable },
+	{ "B", 8, 0, kInformation, kPrefixable | kBinaryPrefixable },
+	{ "Hz", 1, 0, dimension(0, 0, -1), kPrefixable },
+	{ "N", 1, 0, kForce, kPrefixable },
+	{ "lbf", 4.4482216152605, 0, kForce, 0 },
+	{ "Pa", 1, 0, kPressure, kPrefixable },
+	{ "bar", 1e5, 0, kPressure, kPrefixable },
+	{ "atm", 101325, 0, kPressure, 0 },
+	{ "psi", 6894.757293168361, 0, kPressure, 0 },
+	{ "J", 1, 0, kEnergy, kPrefixable },
+	{ "cal", 4.184, 0, kEnergy, kPrefixable },
+	{ "Wh", 3600, 0, kEnergy, kPrefixable },
+	{ "eV", 1.602176634e-19, 0, kEnergy, kPrefixable },
+	{ "W", 1, 0, kPower, kPrefixable },
+	{ "hp", 745.6998715822702, 0, kPower, 0 },
+	{ "V", 1, 0, dimension(2, 1, -3, -1), kPrefixable },
+	{ "L", 1e-3, 0, kVolume, kPrefixable },
+	{ "l", 1e-3, 0, kVolume, kPrefixable },
+	{ "gal", 0.003785411784, 0, kVolume, 0 },
+	{ "ha", 1e4, 0, kArea, 0 },
+	{ "acre", 4046.8564224, 0, kArea, 0 },
+	{ "mph", 0.44704, 0, kSpeed, 0 },
+	{ "kn", 1852.0 / 3600.0, 0, kSpeed, 0 },
+};
+
+static constexpr size_t kUnitCount = sizeof(kUnits) / sizeof(kUnits[0]);
+
+struct PrefixInfo
+{
+	const char* name;
+	double scale;
+	//二进制词头只能用于带kBinaryPrefixable的单位
+	bool binary;
+};
+
+//两个字符的词头在前，保证da、Ki等不会被拆成d、K
+static const PrefixInfo kPrefixes[] = {
+	{ "da", 1e1, false },
+	{ "Ki", 1024.0, true },
+	{ "Mi", 1048576.0, true },
+	{ "Gi", 1073741824.0, true },
+	{ "Ti", 1099511627776.0, true },
+	{ "Pi", 1125899906842624.0, true },
+	{ "Ei", 1152921504606846976.0, true },
+	{ "E", 1e18, false },
+	{ "P", 1e15, false },
+	{ "T", 1e12, false },
+	{ "G", 1e9, false },
+	{ "M", 1e6, false },
+	{ "k", 1e3, false },
+	{ "h", 1e2, false },
+	{ "d", 1e-1, false },
+	{ "c", 1e-2, false },
+	{ "m", 1e-3, false },
+	{ "u", 1e-6, false },
+	{ "n", 1e-9, false },
+	{ "p", 1e-12, false },
+	{ "f", 1e-15, false },
+};
+
+/**
+** 完美哈希：名称的FNV-1a哈希乘以kHashSeed后取高kTableBits位作为槽位
+** kHashSeed是离线搜索得到的使所有单位名称互不冲突的奇数，增删单位后需要重新搜索，编译期会检查是否仍无冲突
+*/
+static constexpr int kTableBits = 7;
+static constexpr size_t kTableSize = size_t(1) << kTableBits;
+static constexpr uint32_t kHashSeed = 26721;
+
+constexpr size_t nameLength(const char* name)
+{
+	size_t length = 0;
+	while (name[length] != 0) ++length;
+	return length;
+}
+
+constexpr size_t hashSlot(const char* name, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= static_cast<uint8_t>(name[i]);
+		hash *= 16777619u;
+	}
+	return static_cast<uint32_t>(hash * kHashSeed) >> (32 - kTableBits);
+}
+
+/**
+** 槽位到单位的映射，0为空槽位，否则为单位下标加1
+*/
+struct HashTable
+{
+	uint8_t slots[kTableSize];
+	bool perfect;
+};
+
+constexpr HashTable buildTable()
+{
+	HashTable table{};
+	table.perfect = true;
+	for (size_t i = 0; i < kUnitCount; ++i)
+	{
+		size_t slot = hashSlot(kUnits[i].name, nameLength(kUnits[i].name));
+		if (table.slots[slot] != 0) table.perfect = false;
+		table.slots[slot] = static_cast<uint8_t>(i + 1);
+	}
+	return table;
+}
+
+static constexpr HashTable kTable = buildTable();
+static_assert(kTable.perfect, "unit names collide in the hash table, search for a new kHashSeed");
+
+/**
+** 按完整名称查找单位表
+** @return 找不到时返回nullptr
+*/
+static const UnitInfo* findUnit(const char* name, size_t length)
+{
+	uint8_t index = kTable.slots[hashSlot(name, length)];
+	if (index == 0) return nullptr;
+
+	const UnitInfo& info = kUnits[index - 1];
+	if (strncmp(info.name, name, length) != 0 || info.name[length] != 0) return nullptr;
+	return &info;
+}
+
+bool util_unit::IsDimensionless(const Dimension& dimension)
+{
+	for (int8_t exponent : dimension.exponents)
+	{
+		if (exponent != 0) return false;
+	}
+	return true;
+}
+
+bool util_unit::SameDimension(const Dimension& a, const Dimension& b)
+{
+	return memcmp(a.exponents, b.exponents, sizeof(a.exponents)) == 0;
+}
+
+bool util_unit::Combine(const Dimension& a, const Dimension& b, int sign, Dimension& result)
+{
+	for (int i = 0; i < kBaseDimensions; ++i)
+	{
+		int exponent = a.exponents[i] + sign * b.exponents[i];
+		if (exponent < INT8_MIN || exponent > INT8_MAX) return false;
+		result.exponents[i] = static_cast<int8_t>(exponent);
+	}
+	return true;
+}
+
+bool util_unit::Scale(const Dimension& a, double factor, Dimension& result)
+{
+	for (int i = 0; i < kBaseDimensions; ++i)
+	{
+		double exponent = a.exponents[i] * factor;
+		if (floor(exponent) != exponent || exponent < INT8_MIN || exponent > INT8_MAX) return false;
+		result.exponents[i] = static_cast<int8_t>(exponent);
+	}
+	return true;
+}
+
+bool util_unit::Lookup(const char* name, size_t length, Unit& unit)
+{
+	if (length == 0 || length > kMaxNameLength) return false;
+
+	const UnitInfo* info = findUnit(name, length);
+	double scale = 1;
+	if (info == nullptr)
+	{
+		for (const PrefixInfo& prefix : kPrefixes)
+		{
+			//先比较首字符，多数词头不需要完整比较
+			if (prefix.name[0] != name[0]) continue;
+
+			size_t prefix_length = prefix.name[1] != 0 ? 2 : 1;
+			if (length <= prefix_length || strncmp(prefix.name, name, prefix_length) != 0) continue;
+
+			info = findUnit(name + prefix_length, length - prefix_length);
+			if (info != nullptr && (info->flags & (prefix.binary ? kBinaryPrefixable : kPrefixable)) != 0)
+			{
+				scale = prefix.scale;
+				break;
+			}
+			info = nullptr;
+		}
+		if (info == nullptr) return false;
+	}
+
+	unit.scale = scale * info->scale;
+	unit.offset = info->offset;
+	unit.dimension = info->dimension;
+	unit.affine = info->offset != 0;
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+** 带单位的量与单位表
+** 单位表在编译期构造为完美哈希表，查找时不分配内存
+** 所有量都换算为国际单位制的基本单位保存，量纲记为各基本量纲的指数
+*/
+namespace util_unit {
+	//基本量纲的个数：长度、质量、时间、电流、温度、物质的量、发光强度、信息量（比特）
+	constexpr int kBaseDimensions = 8;
+	//单位名称（含词头）的最大长度
+	constexpr size_t kMaxNameLength = 8;
+
+	struct Dimension
+	{
+		int8_t exponents[kBaseDimensions];
+	};
+
+	/**
+	** 数值与量纲，数值以基本单位计
+	*/
+	struct Quantity
+	{
+		double value;
+		Dimension dimension;
+	};
+
+	/**
+	** 查找到的单位，x个该单位等于 (x + offset) * scale 个基本单位
+	** 只有摄氏度、华氏度这样的温度单位offset不为0（affine为true），它们只能用于换算温度值，不能参与运算
+	*/
+	struct Unit
+	{
+		double scale;
+		double offset;
+		Dimension dimension;
+		bool affine;
+	};
+
+	bool IsDimensionless(const Dimension& dimension);
+	bool SameDimension(const Dimension& a, const Dimension& b);
+
+	/**
+	** 计算 a + sign * b，用于乘除法
+	** @return 指数超出范围时返回false
+	*/
+	bool Combine(const Dimension& a, const Dimension& b, int sign, Dimension& result);
+
+	/**
+	** 计算 a * factor，用于乘方与开方
+	** @return 某个指数乘以factor后不是整数或超出范围时返回false
+	*/
+	bool Scale(const Dimension& a, double factor, Dimension& result);
+
+	/**
+	** 查找单位，名称可以带国际单位制词头（如km、mA），字节与比特还可以带二进制词头（如KiB、Mibit）
+	** 完整的单位名称优先于词头与单位的拆分
+	** @param name 名称
+	** @param length 名称长度
+	** @param unit 写入查找结果
+	** @return 找不到时返回false
+	*/
+	bool Lookup(const char* name, size_t length, Unit& unit);
+};
@@ -0,0 +1,215 @@
+/*
+* 计算服务的压测客户端
+* 每个连接一个线程，连接上保持固定数量的请求在途，统计吞吐量与延迟分位数
+*/
+
+#include "protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+	std::string socket_path = "/tmp/calculator.sock";
+	//默认请求为GBK编码的“计算 1+2*3”
+	std::string message = "\xbc\xc6\xcb\xe3 1+2*3";
+	size_t connections = 4;
+	size_t pipeline = 16;
+	size_t requests = 100000;
+};
+
+struct Stats
+{
+	std::vector<double> latencies_us;
+	size_t errors = 0;
+	size_t ignored = 0;
+};
+
+static bool WriteAll(int fd, const char* data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+/**
+** 单个连接的压测循环
+** @param options 压测参数
+** @param count 本连接发送的请求数
+** @param stats 写入统计结果
+*/
+static void RunConnection(const Options& options, size_t count, Stats& stats)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, options.socket_path.c_str());
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+	{
+		perror(options.socket_path.c_str());
+		stats.errors += count;
+		if (fd >= 0) close(fd);
+		return;
+	}
+
+	std::string frame;
+	protocol::AppendFrame(frame, options.message.data(), options.message.size());
+
+	std::deque<Clock::time_point> inflight;
+	std::string in;
+	size_t offset = 0;
+	size_t sent = 0, received = 0;
+	stats.latencies_us.reserve(count);
+
+	while (received < count)
+	{
+		//补足在途请求，多个请求合并为一次写入
+		std::string batch;
+		while (sent < count && inflight.size() < options.pipeline)
+		{
+			batch += frame;
+			inflight.push_back(Clock::now());
+			++sent;
+		}
+		if (!batch.empty() && !WriteAll(fd, batch.data(), batch.size()))
+		{
+			stats.errors += count - received;
+			break;
+		}
+
+		char buf[64 << 10];
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0)
+		{
+			stats.errors += count - received;
+			break;
+		}
+		in.append(buf, n);
+
+		size_t begin, len;
+		while (protocol::ParseFrame(in, offset, begin, len) == 1)
+		{
+			Clock::time_point now = Clock::now();
+			stats.latencies_us.push_back(std::chrono::duration<double, std::micro>(now - inflight.front()).count());
+			inflight.pop_front();
+			++received;
+			if (len == 0) ++stats.errors;
+			else if (in[begin] != protocol::kHandled) ++stats.ignored;
+		}
+
+		if (offset == in.size())
+		{
+			in.clear();
+			offset = 0;
+		}
+	}
+
+	close(fd);
+}
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0;
+	size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void Usage(const char* name)
+{
+	fprintf(stderr,
+		"usage: %s [-s socket_path] [-c connections] [-p pipeline] [-n requests] [-m message]\n"
+		"  -s  Unix domain socket path (default /tmp/calculator.sock)\n"
+		"  -c  concurrent connections (default 4)\n"
+		"  -p  requests kept in flight per connection (default 16)\n"
+		"  -n  total requests (default 100000)\n"
+		"  -m  request message, sent as-is (default: GBK \"calculate 1+2*3\")\n",
+		name);
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:c:p:n:m:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			options.socket_path = optarg;
+			break;
+		case 'c':
+			options.connections = strtoul(optarg, nullptr, 10);
+			break;
+		case 'p':
+			options.pipeline = strtoul(optarg, nullptr, 10);
+			break;
+		case 'n':
+			options.requests = strtoul(optarg, nullptr, 10);
+			break;
+		case 'm':
+			options.message = optarg;
+			break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (options.connections == 0 || options.pipeline == 0 || options.socket_path.size() >= sizeof(sockaddr_un::sun_path))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<Stats> stats(options.connections);
+	std::vector<std::thread> threads;
+
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < options.connections; ++i)
+	{
+		//请求数尽量平均分给各个连接
+		size_t count = options.requests / options.connections + (i < options.requests % options.connections ? 1 : 0);
+		threads.emplace_back(RunConnection, std::cref(options), count, std::ref(stats[i]));
+	}
+	for (std::thread& thread : threads) thread.join();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<double> latencies;
+	size_t errors = 0, ignored = 0;
+	for (Stats& s : stats)
+	{
+		latencies.insert(latencies.end(), s.latencies_us.begin(), s.latencies_us.end());
+		errors += s.errors;
+		ignored += s.ignored;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("requests: %zu  errors: %zu  not handled: %zu  time: %.3f s\n", latencies.size(), errors, ignored, seconds);
+	printf("throughput: %.0f req/s\n", latencies.size() / seconds);
+	printf("latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+		Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99),
+		Percentile(latencies, 0.999), latencies.empty() ? 0 : latencies.back());
+	return errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,826 @@
+/*
+* 计算引擎的微基准测试
+* 不经过网络，直接调用引擎各模块，输出每项操作的耗时与相关统计
+* 用法：calculator-engine-bench [名称 ...]，不带参数时运行全部，-l 列出全部名称
+*/
+
+#include "../Calculator-CoolQ/dispose.h"
+#include "../Calculator-CoolQ/util/decimal.h"
+#include "../Calculator-CoolQ/util/integrate.h"
+#include "../Calculator-CoolQ/util/modmath.h"
+#include "../Calculator-CoolQ/util/prime.h"
+#include "../Calculator-CoolQ/util/radix.h"
+#include "../Calculator-CoolQ/util/result_cache.h"
+#include "../Calculator-CoolQ/util/rpn.h"
+#include "../Calculator-CoolQ/util/solve.h"
+#include "../Calculator-CoolQ/util/thread_pool.h"
+#include "../Calculator-CoolQ/util/units.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+//rpn.cpp中未在头文件声明的两步计算接口，作为流式计算的对照组
+Expected<std::string> MakeRpn(const std::string& math_exp);
+Expected<double> CalculateRpn(const std::string& rpn_exp);
+
+//GBK编码的计算命令“计算”
+static const std::string kCalculate = "\xbc\xc6\xcb\xe3 ";
+//每项计时至少持续的时间
+static const double kMinSeconds = 0.2;
+
+//防止被计时的结果被编译器优化掉
+static volatile double sink;
+//某项基准附带的结果检查失败，main返回非0
+static bool mismatch = false;
+
+static double Seconds(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//当前与峰值堆内存，由下面替换的全局operator new/delete统计
+static std::atomic<size_t> heap_current(0), heap_peak(0);
+
+void* operator new(size_t size)
+{
+	void* p = malloc(size != 0 ? size : 1);
+	if (p == nullptr) throw std::bad_alloc();
+	size_t current = heap_current.fetch_add(malloc_usable_size(p), std::memory_order_relaxed) + malloc_usable_size(p);
+	size_t peak = heap_peak.load(std::memory_order_relaxed);
+	while (current > peak && !heap_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+	return p;
+}
+
+//不内联，否则gcc会把这里的free与调用处的new配对而误报不匹配
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	if (p == nullptr) return;
+	heap_current.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+/**
+** 执行fn并返回期间堆内存峰值相对开始时的增量（字节）
+*/
+template <class F>
+static size_t PeakHeap(F fn)
+{
+	size_t base = heap_current.load();
+	heap_peak.store(base);
+	fn();
+	return heap_peak.load() - base;
+}
+
+/**
+** 反复调用fn，次数按倍增直到总耗时不少于kMinSeconds
+** @return 每次调用的平均纳秒数
+*/
+template <class F>
+static double TimeNs(F fn)
+{
+	for (size_t count = 1;; count *= 2)
+	{
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < count; ++i) fn(i);
+		double seconds = Seconds(start);
+		if (seconds >= kMinSeconds) return seconds * 1e9 / count;
+	}
+}
+
+/**
+** 按Zipf分布（指数为1）生成n个键中的下标，模拟少数热门问题占大多数请求
+*/
+static std::vector<size_t> ZipfStream(size_t keys, size_t length, unsigned seed)
+{
+	std::vector<double> weights(keys);
+	for (size_t i = 0; i < keys; ++i) weights[i] = 1.0 / (i + 1);
+	std::discrete_distribution<size_t> distribution(weights.begin(), weights.end());
+	std::mt19937 random(seed);
+
+	std::vector<size_t> stream(length);
+	for (size_t& index : stream) index = distribution(random);
+	return stream;
+}
+
+static void BenchCache()
+{
+	char path[] = "/tmp/calculator-bench-cache-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+	{
+		perror("mkstemp");
+		return;
+	}
+	close(fd);
+	unlink(path);
+
+	//打开：第一次访问时建立文件，之后重新打开只检查文件头
+	util_cache::Init(path);
+	std::string value;
+	Clock::time_point start = Clock::now();
+	util_cache::Find("warm", value);
+	printf("  create 16 MiB cache file      %8.1f us\n", Seconds(start) * 1e6);
+
+	std::vector<std::string> keys(200000);
+	for (size_t i = 0; i < keys.size(); ++i) keys[i] = "0|" + std::to_string(i) + "*" + std::to_string(i) + "+1";
+	for (size_t i = 0; i < 60000; ++i) util_cache::Store(keys[i], "12345.678");
+	util_cache::Close();
+
+	util_cache::Init(path);
+	start = Clock::now();
+	util_cache::Find("warm", value);
+	printf("  reopen full cache file        %8.1f us\n", Seconds(start) * 1e6);
+
+	size_t restored = 0;
+	for (size_t i = 0; i < 60000; ++i) restored += util_cache::Find(keys[i], value);
+	printf("  entries kept across restart   %8.1f %%  (60000 stored in 65536 slots)\n", 100.0 * restored / 60000);
+
+	printf("  Find hit                      %8.1f ns\n", TimeNs([&](size_t i) { sink = util_cache::Find(keys[i % 1000], value); }));
+	printf("  Find miss                     %8.1f ns\n", TimeNs([&](size_t i) { sink = util_cache::Find(keys[100000 + i % 1000], value); }));
+	printf("  Store                         %8.1f ns\n", TimeNs([&](size_t i) { util_cache::Store(keys[i % 1000], "12345.678"); }));
+
+	//热门问题的命中率：每个请求先查缓存，未命中时写入
+	util_cache::Close();
+	unlink(path);
+	util_cache::Init(path);
+	std::vector<size_t> stream = ZipfStream(keys.size(), 1000000, 1);
+	std::unordered_set<size_t> seen;
+	size_t hits = 0, repeats = 0;
+	for (size_t index : stream)
+	{
+		if (util_cache::Find(keys[index], value))
+			++hits;
+		else
+			util_cache::Store(keys[index], "12345.678");
+		repeats += !seen.insert(index).second;
+	}
+	printf("  Zipf hit rate, 200k keys      %8.1f %%  (unbounded cache: %.1f %%)\n",
+		100.0 * hits / stream.size(), 100.0 * repeats / stream.size());
+
+	//整条消息的处理：重复的问题直接取缓存结果
+	std::string message = kCalculate + "sqrt(2)*pi^3+ln(10)/exp(1.5)-2^0.5*3";
+	std::string result;
+	util_cache::Close();
+	util_cache::Init("");
+	double uncached = TimeNs([&](size_t) { Dispose(1, 0, 0, message, result); });
+	util_cache::Init(path);
+	double cached = TimeNs([&](size_t) { Dispose(1, 0, 0, message, result); });
+	printf("  Dispose without cache         %8.1f ns\n", uncached);
+	printf("  Dispose, cache hit            %8.1f ns\n", cached);
+
+	util_cache::Close();
+	unlink(path);
+}
+
+/**
+** 对照组：每一步都用128位乘积对模数取余的普通快速幂
+*/
+static uint64_t NaivePowMod(uint64_t base, uint64_t exponent, uint64_t m)
+{
+	uint64_t result = 1 % m;
+	base %= m;
+	while (exponent)
+	{
+		if (exponent & 1) result = util_mod::MulMod(result, base, m);
+		base = util_mod::MulMod(base, base, m);
+		exponent >>= 1;
+	}
+	return result;
+}
+
+static void BenchModMath()
+{
+	std::mt19937_64 random(2);
+	std::vector<uint64_t> bases(1024), exponents(1024), odd(1024), even(1024);
+	for (size_t i = 0; i < bases.size(); ++i)
+	{
+		bases[i] = random();
+		exponents[i] = random();
+		odd[i] = (random() >> 2) | (1ULL << 61) | 1;
+		even[i] = odd[i] + 1;
+	}
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < bases.size(); ++i)
+	{
+		mismatches += util_mod::PowMod(bases[i], exponents[i], odd[i]) != NaivePowMod(bases[i], exponents[i], odd[i]);
+		mismatches += util_mod::PowMod(bases[i], exponents[i], even[i]) != NaivePowMod(bases[i], exponents[i], even[i]);
+	}
+	printf("  mismatches vs naive                %7zu of %zu\n", mismatches, 2 * bases.size());
+
+	//64位指数、62位模数
+	printf("  PowMod, odd modulus (Montgomery)   %7.0f ns\n", TimeNs([&](size_t i) {
+		sink = static_cast<double>(util_mod::PowMod(bases[i % 1024], exponents[i % 1024], odd[i % 1024]));
+	}));
+	printf("  PowMod, even modulus (128-bit)     %7.0f ns\n", TimeNs([&](size_t i) {
+		sink = static_cast<double>(util_mod::PowMod(bases[i % 1024], exponents[i % 1024], even[i % 1024]));
+	}));
+	printf("  naive square-and-multiply          %7.0f ns\n", TimeNs([&](size_t i) {
+		sink = static_cast<double>(NaivePowMod(bases[i % 1024], exponents[i % 1024], odd[i % 1024]));
+	}));
+	printf("  InvMod                             %7.0f ns\n", TimeNs([&](size_t i) {
+		uint64_t inverse;
+		sink = util_mod::InvMod(bases[i % 1024], odd[i % 1024], inverse);
+	}));
+
+	std::string expr = "3^1000 % 7";
+	Expected<double> value = CalculateExpr(expr);
+	printf("  CalculateExpr(\"%s\") = %-7g  %7.0f ns\n", expr.c_str(), value.Value(),
+		TimeNs([&](size_t) { sink = CalculateExpr(expr).Value(); }));
+}
+
+/**
+** 对照组：只用奇数试除到平方根的质因数分解
+*/
+static std::vector<uint64_t> TrialFactor(uint64_t n)
+{
+	std::vector<uint64_t> factors;
+	while (n % 2 == 0)
+	{
+		factors.push_back(2);
+		n /= 2;
+	}
+	for (uint64_t d = 3; d <= n / d; d += 2)
+	{
+		while (n % d == 0)
+		{
+			factors.push_back(d);
+			n /= d;
+		}
+	}
+	if (n > 1) factors.push_back(n);
+	return factors;
+}
+
+/**
+** 生成两个位数各为bits/2的素数之积
+*/
+static uint64_t Semiprime(int bits, std::mt19937_64& random)
+{
+	uint64_t factors[2];
+	for (uint64_t& p : factors)
+	{
+		p = (random() >> (64 - bits / 2)) | (1ULL << (bits / 2 - 1)) | 1;
+		while (!util_prime::IsPrime(p)) p += 2;
+	}
+	return factors[0] * factors[1];
+}
+
+static void BenchPrime()
+{
+	util_prime::Init();
+	std::mt19937_64 random(3);
+	std::vector<std::pair<uint64_t, int>> factors;
+
+	//两个因子大小相同的半素数是试除的最坏情况，试除到2^62需要数秒，只比较到56位
+	for (int bits : { 40, 48, 56, 62 })
+	{
+		std::vector<uint64_t> inputs(16);
+		for (uint64_t& n : inputs) n = Semiprime(bits, random);
+
+		size_t failures = 0;
+		for (uint64_t n : inputs) failures += !util_prime::Factor(n, factors) || factors.size() != 2;
+		double rho = TimeNs([&](size_t i) { sink = util_prime::Factor(inputs[i % inputs.size()], factors); });
+
+		if (bits <= 56)
+		{
+			double trial = TimeNs([&](size_t i) { sink = static_cast<double>(TrialFactor(inputs[i % inputs.size()]).size()); });
+			printf("  %d-bit semiprime   Factor %9.1f us   trial division %11.1f us   (%zu failed)\n",
+				bits, rho / 1e3, trial / 1e3, failures);
+		}
+		else
+		{
+			printf("  %d-bit semiprime   Factor %9.1f us   trial division %11s      (%zu failed)\n",
+				bits, rho / 1e3, "-", failures);
+		}
+	}
+
+	std::vector<uint64_t> primes(16);
+	for (uint64_t& p : primes)
+	{
+		p = random() | (1ULL << 63) | 1;
+		while (!util_prime::IsPrime(p)) p += 2;
+	}
+	printf("  IsPrime, 64-bit prime        %9.1f us\n", TimeNs([&](size_t i) { sink = util_prime::IsPrime(primes[i % primes.size()]); }) / 1e3);
+}
+
+static void BenchStream()
+{
+	//括号包住整个表达式，使CalculateExpr不切分并行计算，只比较单线程的流式计算
+	for (size_t megabytes : { 1, 4, 16 })
+	{
+		std::mt19937 random(4);
+		std::string expr = "(";
+		while (expr.length() < megabytes << 20)
+		{
+			expr += std::to_string(random() % 100000) + "." + std::to_string(random() % 1000);
+			expr += "+-*/"[random() % 4];
+			if (random() % 8 == 0) expr += "(" + std::to_string(random() % 1000 + 1) + "-0.5)*";
+		}
+		expr += "1)";
+
+		double streamed = 0, two_pass = 0;
+		size_t stream_heap = PeakHeap([&] { streamed = CalculateExpr(expr).Value(); });
+		size_t two_pass_heap = PeakHeap([&] {
+			Expected<std::string> rpn = MakeRpn(expr);
+			two_pass = CalculateRpn(rpn.Value()).Value();
+		});
+
+		Clock::time_point start = Clock::now();
+		sink = CalculateExpr(expr).Value();
+		double stream_seconds = Seconds(start);
+		start = Clock::now();
+		sink = CalculateRpn(MakeRpn(expr).Value()).Value();
+		double two_pass_seconds = Seconds(start);
+
+		bool same = memcmp(&streamed, &two_pass, sizeof(double)) == 0;
+		mismatch = mismatch || !same;
+		printf("  %2zu MiB  streaming %6.1f MB/s, peak heap %8.1f KiB   MakeRpn+CalculateRpn %6.1f MB/s, peak heap %8.1f KiB   %s\n",
+			megabytes, expr.length() / stream_seconds / 1e6, stream_heap / 1024.0,
+			expr.length() / two_pass_seconds / 1e6, two_pass_heap / 1024.0, same ? "same result" : "RESULTS DIFFER");
+	}
+}
+
+static void BenchParallel()
+{
+	printf("  thread pool concurrency %zu\n", util_pool::Concurrency());
+	for (size_t megabytes : { 4, 16 })
+	{
+		std::mt19937 random(5);
+		std::string expr;
+		while (expr.length() < megabytes << 20)
+		{
+			expr += std::to_string(random() % 100000) + "." + std::to_string(random() % 100000);
+			if (random() % 4 == 0) expr += "*(3.1-" + std::to_string(random() % 7) + ")/7";
+			expr += random() % 2 ? "+" : "-";
+		}
+		expr += "1";
+		std::string wrapped = "(" + expr + ")";
+
+		Clock::time_point start = Clock::now();
+		double split = CalculateExpr(expr).Value();
+		double split_seconds = Seconds(start);
+		start = Clock::now();
+		double sequential = CalculateExpr(wrapped).Value();
+		double sequential_seconds = Seconds(start);
+
+		//两个线程同时计算，线程池不再串行化各自的Run
+		start = Clock::now();
+		double concurrent[2];
+		std::thread other([&] { concurrent[1] = CalculateExpr(expr).Value(); });
+		concurrent[0] = CalculateExpr(expr).Value();
+		other.join();
+		double concurrent_seconds = Seconds(start);
+
+		bool same = memcmp(&split, &sequential, sizeof(double)) == 0
+			&& memcmp(&concurrent[0], &split, sizeof(double)) == 0 && memcmp(&concurrent[1], &split, sizeof(double)) == 0;
+		mismatch = mismatch || !same;
+		printf("  %2zu MiB  split %6.1f MB/s   sequential %6.1f MB/s   2 callers %6.1f MB/s   %s\n",
+			megabytes, expr.length() / split_seconds / 1e6, expr.length() / sequential_seconds / 1e6,
+			2 * expr.length() / concurrent_seconds / 1e6, same ? "bit-identical" : "RESULTS DIFFER");
+	}
+
+	//紧跟在常数名之后的顶层加减号同样是切分点，不能在段内被归约
+	std::string ones;
+	for (int i = 0; i < 600000; ++i) ones += "1+";
+	for (const char* tail : { "pi+5", "pi-5", "e+5", "2*pi-5" })
+	{
+		std::string expr = ones + tail;
+		double split = CalculateExpr(expr).Value();
+		double sequential = CalculateExpr("(" + expr + ")").Value();
+		bool same = memcmp(&split, &sequential, sizeof(double)) == 0;
+		mismatch = mismatch || !same;
+		printf("  600000 x \"1+\" then %-7s split %.17g   sequential %.17g   %s\n", tail, split, sequential,
+			same ? "bit-identical" : "RESULTS DIFFER");
+	}
+}
+
+/**
+** 对照组：原先的出错方式，抛出const char*后在两层调用中各捕获一次
+*/
+static double ThrowTwice(const std::string& expr)
+{
+	try
+	{
+		try
+		{
+			if (expr.find_first_not_of("0123456789+-*/^(). ") != std::string::npos) throw "kExpressionError";
+			return 0;
+		}
+		catch (const char*)
+		{
+			throw;
+		}
+	}
+	catch (const char*)
+	{
+		return -1;
+	}
+}
+
+static void BenchErrors()
+{
+	//长度相近的合法与非法输入，非法输入覆盖各种错误码，出错位置有前有后
+	static const char* const kValid[] = { "1+1", "2*(3+4)", "sqrt(2)*pi", "(1+2)*(3+4)/5", "2^10-1", "100/7", "ln(10)+exp(1)", "3^1000 % 7" };
+	static const char* const kMalformed[] = { "haha", "1+", "(1+2", "1/0", "sqrt(-1)", "1.2.3", "2*(3+)", "powmod(1,2)" };
+
+	std::vector<std::string> valid(std::begin(kValid), std::end(kValid));
+	std::vector<std::string> malformed(std::begin(kMalformed), std::end(kMalformed));
+	size_t errors = 0;
+	for (const std::string& expr : malformed) errors += !CalculateExpr(expr);
+	printf("  malformed inputs rejected           %zu of %zu\n", errors, malformed.size());
+
+	printf("  CalculateExpr, valid                %7.1f ns\n", TimeNs([&](size_t i) {
+		Expected<double> value = CalculateExpr(valid[i % valid.size()]);
+		sink = value ? value.Value() : 0;
+	}));
+	printf("  CalculateExpr, malformed            %7.1f ns\n", TimeNs([&](size_t i) {
+		Expected<double> value = CalculateExpr(malformed[i % malformed.size()]);
+		sink = value ? value.Value() : static_cast<double>(value.Error().position);
+	}));
+	printf("  throw + rethrow + catch (old path)  %7.1f ns\n", TimeNs([&](size_t i) { sink = ThrowTwice(malformed[i % malformed.size()]); }));
+
+	//整条消息的处理，包括生成带出错位置的提示
+	std::string result;
+	util_cache::Init("");
+	printf("  Dispose, valid                      %7.1f ns\n", TimeNs([&](size_t i) {
+		Dispose(1, 0, 0, kCalculate + valid[i % valid.size()], result);
+	}));
+	printf("  Dispose, malformed                  %7.1f ns\n", TimeNs([&](size_t i) {
+		Dispose(1, 0, 0, kCalculate + malformed[i % malformed.size()], result);
+	}));
+}
+
+static void BenchDecimal()
+{
+	using util_decimal::Decimal;
+
+	std::mt19937_64 random(6);
+	std::vector<Decimal> a(1024), b(1024);
+	std::vector<double> x(1024), y(1024);
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		a[i] = Decimal{ static_cast<int64_t>(random() % 1000000000000ULL) + 1, -static_cast<int32_t>(random() % 8) };
+		b[i] = Decimal{ static_cast<int64_t>(random() % 1000000ULL) + 1, -static_cast<int32_t>(random() % 4) };
+		x[i] = util_decimal::ToDouble(a[i]);
+		y[i] = util_decimal::ToDouble(b[i]);
+	}
+
+	Decimal r;
+	printf("  Add         decimal %6.1f ns   double %5.1f ns\n",
+		TimeNs([&](size_t i) { util_decimal::Add(a[i % 1024], b[i % 1024], r); sink = static_cast<double>(r.coefficient); }),
+		TimeNs([&](size_t i) { sink = x[i % 1024] + y[i % 1024]; }));
+	printf("  Mul         decimal %6.1f ns   double %5.1f ns\n",
+		TimeNs([&](size_t i) { util_decimal::Mul(a[i % 1024], b[i % 1024], r); sink = static_cast<double>(r.coefficient); }),
+		TimeNs([&](size_t i) { sink = x[i % 1024] * y[i % 1024]; }));
+	printf("  Div, 16 dig decimal %6.1f ns   double %5.1f ns\n",
+		TimeNs([&](size_t i) { util_decimal::Div(a[i % 1024], b[i % 1024], 16, r); sink = static_cast<double>(r.coefficient); }),
+		TimeNs([&](size_t i) { sink = x[i % 1024] / y[i % 1024]; }));
+	//指数-7、-40：前者快速幂全程精确，后者中间结果超过18位，改用带保护位的任意精度只舍入一次
+	printf("  Pow ^-7     decimal %6.1f ns   double %5.1f ns\n",
+		TimeNs([&](size_t i) { util_decimal::Pow(Decimal{ static_cast<int64_t>(i % 97 + 2), 0 }, Decimal{ -7, 0 }, 16, r); sink = static_cast<double>(r.coefficient); }),
+		TimeNs([&](size_t i) { sink = pow(static_cast<double>(i % 97 + 2), -7); }));
+	printf("  Pow ^-40    decimal %6.1f ns   double %5.1f ns\n",
+		TimeNs([&](size_t i) { util_decimal::Pow(a[i % 1024], Decimal{ -40, 0 }, 16, r); sink = static_cast<double>(r.coefficient); }),
+		TimeNs([&](size_t i) { sink = pow(x[i % 1024], -40); }));
+
+	char buffer[32];
+	printf("  Format      decimal %6.1f ns   %%.17g %5.1f ns\n",
+		TimeNs([&](size_t i) { sink = static_cast<double>(util_decimal::Format(a[i % 1024]).size()); }),
+		TimeNs([&](size_t i) { sink = snprintf(buffer, sizeof(buffer), "%.17g", x[i % 1024]); }));
+
+	//整条表达式：解析占大部分时间
+	std::string expr;
+	std::mt19937 text_random(6);
+	while (expr.length() < (1 << 20))
+	{
+		expr += std::to_string(text_random() % 100000) + "." + std::to_string(text_random() % 1000);
+		expr += "+-*/"[text_random() % 4];
+	}
+	expr += "1";
+	std::string wrapped = "(" + expr + ")";
+	Clock::time_point start = Clock::now();
+	sink = CalculateDecimal(wrapped, 16) ? 1 : 0;
+	double decimal_seconds = Seconds(start);
+	start = Clock::now();
+	sink = CalculateExpr(wrapped).Value();
+	double double_seconds = Seconds(start);
+	printf("  1 MiB mixed decimal %6.1f MB/s   double %5.1f MB/s\n",
+		expr.length() / decimal_seconds / 1e6, expr.length() / double_seconds / 1e6);
+	printf("  0.1+0.2     decimal %6.1f ns   double %5.1f ns\n",
+		TimeNs([&](size_t) { sink = static_cast<double>(CalculateDecimal("0.1+0.2", 16).Value().coefficient); }),
+		TimeNs([&](size_t) { sink = CalculateExpr("0.1+0.2").Value(); }));
+}
+
+static void BenchBig()
+{
+	//每个表达式只计时一次；精度从低到高，π、e的缓存每次都需要重新计算
+	static const char* const kExprs[] = { "pi", "e", "sqrt(2)", "exp(1)", "ln(2)", "2^0.5" };
+	printf("  %-10s", "digits");
+	for (const char* expr : kExprs) printf(" %10s", expr);
+	printf("\n");
+	for (int digits : { 1000, 10000, 100000 })
+	{
+		printf("  %-10d", digits);
+		for (const char* expr : kExprs)
+		{
+			Clock::time_point start = Clock::now();
+			Expected<util_big::Float> value = CalculateBig(expr, digits);
+			double ms = Seconds(start) * 1e3;
+			if (value)
+				printf(" %7.1f ms", ms);
+			else
+				printf(" %7.1f ms*", ms);
+		}
+		printf("\n");
+	}
+	printf("  (* = stopped by the work budget)\n");
+
+	//超出计算量上限的请求应当尽快失败
+	static const struct { int digits; const char* expr; } kFailing[] = {
+		{ 100000, "ln(3)" },
+		{ 100000, "exp(ln(3))" },
+		{ 100000, "pi^pi^pi" },
+		{ 100000, "exp(exp(exp(1)))" },
+		{ 30000, "ln(2)+ln(3)+ln(5)+ln(7)" },
+		{ 40000, "ln(2)+ln(3)+ln(5)+ln(7)" },
+	};
+	for (const auto& failing : kFailing)
+	{
+		Clock::time_point start = Clock::now();
+		Expected<util_big::Float> value = CalculateBig(failing.expr, failing.digits);
+		double ms = Seconds(start) * 1e3;
+		printf("  %-26s %6d digits  %7.1f ms  %s\n", failing.expr, failing.digits, ms,
+			value ? "ok" : value.Error().code == CalcErrc::kBudgetExceeded ? "budget exceeded" : "error");
+	}
+}
+
+static void BenchSolve()
+{
+	static const struct { const char* expr; double a, b; } kCases[] = {
+		{ "x^3-2x-5", -10, 10 },
+		{ "x^5-5x^3+4x", -3, 3 },
+		{ "exp(x)-3x", 0, 3 },
+		{ "ln(x)+x-2", 0.1, 10 },
+		{ "exp(0-x)-x/10", 0, 100 },
+		//乘方紧接取模按模幂精确计算，与CalculateExpr相同
+		{ "x^1000 % 7 - 4", 2.5, 3.5 },
+		//区间宽度超出double范围
+		{ "x-1e300", -1e308, 1e308 },
+	};
+	for (const auto& c : kCases)
+	{
+		Program program = CompileExpr(c.expr, "x").Value();
+		util_solve::Roots roots = util_solve::Solve(program, c.a, c.b).Value();
+		double ns = TimeNs([&](size_t) { sink = static_cast<double>(util_solve::Solve(program, c.a, c.b).Value().values.size()); });
+		char interval[32];
+		snprintf(interval, sizeof(interval), "[%g, %g]", c.a, c.b);
+		printf("  %-14s %-18s %6.1f us  %zu roots:", c.expr, interval, ns / 1e3, roots.values.size());
+		for (double root : roots.values) printf(" %.12g", root);
+		printf("\n");
+	}
+
+	//扫描网格的批量求值与逐点求值的对照
+	Program program = CompileExpr("x^5-5x^3+4x", "x").Value();
+	std::vector<double> x(util_solve::kGridIntervals + 1), y(x.size()), stack;
+	for (size_t i = 0; i < x.size(); ++i) x[i] = -3 + 6.0 * i / util_solve::kGridIntervals;
+	printf("  grid of %zu points  batched %6.1f us   one point per call %6.1f us\n", x.size(),
+		TimeNs([&](size_t) { EvaluateProgram(program, x.data(), y.data(), x.size(), stack); sink = y[0]; }) / 1e3,
+		TimeNs([&](size_t) {
+			for (size_t i = 0; i < x.size(); ++i) EvaluateProgram(program, &x[i], &y[i], 1, stack);
+			sink = y[0];
+		}) / 1e3);
+
+	//网格求值超出计算量上限的表达式不做任何求值，直接失败
+	std::string long_expr = "x";
+	while (long_expr.length() < 40000) long_expr += "+x";
+	Program long_program = CompileExpr(long_expr, "x").Value();
+	Clock::time_point start = Clock::now();
+	Expected<util_solve::Roots> failed = util_solve::Solve(long_program, -1, 1);
+	bool exceeded = !failed && failed.Error().code == CalcErrc::kBudgetExceeded;
+	mismatch = mismatch || !exceeded;
+	printf("  %zu-instruction expression fails in %.1f us (%s)\n", long_program.code.size(), Seconds(start) * 1e6,
+		exceeded ? "budget exceeded" : "unexpected");
+}
+
+static void BenchIntegrate()
+{
+	//光滑、端点奇异、分段（锯齿波）的被积函数与精确值
+	static const struct { const char* expr; double a, b, exact; } kCases[] = {
+		{ "exp(-x^2)", -5, 5, 1.772453850902791 },
+		{ "x^3-2x", 0, 2, 0 },
+		{ "exp(x)", 0, 1, 1.718281828459045 },
+		{ "sqrt(x)", 0, 1, 2.0 / 3 },
+		{ "1/sqrt(x)", 0, 1, 2 },
+		{ "ln(x)", 0, 1, -1 },
+		{ "x mod 1", 0, 20, 10 },
+	};
+	for (const auto& c : kCases)
+	{
+		Program program = CompileExpr(c.expr, "x").Value();
+		util_integrate::Integral integral = util_integrate::Integrate(program, c.a, c.b).Value();
+		double ns = TimeNs([&](size_t) { sink = util_integrate::Integrate(program, c.a, c.b).Value().value; });
+		char interval[32];
+		snprintf(interval, sizeof(interval), "[%g, %g]", c.a, c.b);
+		printf("  %-10s %-9s %8.1f us  %6llu evals  error %.1e (estimate %.1e)%s\n", c.expr, interval, ns / 1e3,
+			static_cast<unsigned long long>(integral.evaluations), fabs(integral.value - c.exact), integral.error,
+			integral.converged ? "" : "  not converged");
+	}
+
+	//区间宽度溢出、被积函数过长时不做任何求值，直接失败
+	Program square = CompileExpr("x^2", "x").Value();
+	Expected<util_integrate::Integral> wide = util_integrate::Integrate(square, -1e308, 1e308);
+	bool overflow = !wide && wide.Error().code == CalcErrc::kOverflow;
+	mismatch = mismatch || !overflow;
+	printf("  x^2 on [-1e308, 1e308]: %s\n", overflow ? "overflow" : "unexpected");
+	std::string long_expr = "x";
+	while (long_expr.length() < 14000000) long_expr += "+x";
+	Program long_program = CompileExpr(long_expr, "x").Value();
+	Clock::time_point start = Clock::now();
+	Expected<util_integrate::Integral> failed = util_integrate::Integrate(long_program, 0, 1);
+	bool exceeded = !failed && failed.Error().code == CalcErrc::kBudgetExceeded;
+	mismatch = mismatch || !exceeded;
+	printf("  %zu-instruction integrand fails in %.1f us (%s)\n", long_program.code.size(), Seconds(start) * 1e6,
+		exceeded ? "budget exceeded" : "unexpected");
+}
+
+/**
+** 逐字符解析的对照组
+*/
+static uint64_t ParseRadixScalar(const std::string& digits, int radix)
+{
+	uint64_t value = 0;
+	for (char ch : digits)
+	{
+		int digit = ch <= '9' ? ch - '0' : (ch | 0x20) - 'a' + 10;
+		value = value * radix + digit;
+	}
+	return value;
+}
+
+static void BenchRadix()
+{
+	//字面量的解析结果，其中0b1H、0bcH是以0b开头的后缀写法十六进制数，不能被0b前缀截走
+	static const struct { const char* expr; double value; } kLiterals[] = {
+		{ "0x1B", 27 }, { "0b101", 5 }, { "0o17", 15 }, { "36#z", 35 },
+		{ "101B", 5 }, { "17O", 15 }, { "1FH", 31 }, { "0b1H", 177 }, { "0bcH", 188 },
+		{ "0xffffffffffffffff", 18446744073709551615.0 },
+	};
+	int failures = 0;
+	for (const auto& literal : kLiterals)
+	{
+		Expected<double> value = CalculateExpr(literal.expr);
+		if (!value || value.Value() != literal.value)
+		{
+			printf("  MISMATCH %s\n", literal.expr);
+			++failures;
+		}
+	}
+	printf("  %zu literals checked, %d mismatches\n", sizeof(kLiterals) / sizeof(kLiterals[0]), failures);
+	mismatch = mismatch || failures != 0;
+
+	std::mt19937_64 random(37);
+	for (int radix : { 2, 16 })
+	{
+		//64位二进制、16位十六进制数字都正好是一个64位整数
+		std::vector<std::string> literals(1024);
+		for (std::string& literal : literals)
+		{
+			uint64_t value = random() | (1ULL << 63);
+			while (value != 0)
+			{
+				literal.insert(literal.begin(), "0123456789abcdef"[value % radix]);
+				value /= radix;
+			}
+		}
+
+		uint64_t value;
+		size_t offset;
+		printf("  %2zu-digit base %-2d  SWAR %5.1f ns   per character %5.1f ns   CalculateExpr(\"0%c...\") %5.1f ns\n",
+			literals[0].length(), radix,
+			TimeNs([&](size_t i) {
+				const std::string& literal = literals[i % 1024];
+				util_radix::Parse(literal.data(), literal.data() + literal.length(), radix, value, offset);
+				sink = static_cast<double>(value);
+			}),
+			TimeNs([&](size_t i) { sink = static_cast<double>(ParseRadixScalar(literals[i % 1024], radix)); }),
+			radix == 2 ? 'b' : 'x',
+			TimeNs([&](size_t i) { sink = CalculateExpr((radix == 2 ? "0b" : "0x") + literals[i % 1024]).Value(); }));
+	}
+}
+
+static void BenchUnits()
+{
+	//完整名称、带词头的名称与不存在的名称
+	static const char* const kNames[] = { "m", "mi", "degF", "acre", "km", "KiB", "mbar", "xyz", "kmi" };
+
+	//对照组：以std::string为键的unordered_map，只放入上面能找到的名称
+	std::unordered_map<std::string, util_unit::Unit> map;
+	for (const char* name : kNames)
+	{
+		util_unit::Unit unit;
+		if (util_unit::Lookup(name, strlen(name), unit)) map[name] = unit;
+	}
+
+	for (const char* name : kNames)
+	{
+		size_t length = strlen(name);
+		util_unit::Unit unit;
+		bool found = util_unit::Lookup(name, length, unit);
+		size_t heap = PeakHeap([&] { for (int i = 0; i < 1000; ++i) util_unit::Lookup(name, length, unit); });
+		printf("  Lookup %-5s %-9s %5.1f ns  %zu bytes allocated   unordered_map<string> %5.1f ns\n", name,
+			found ? "found" : "not found",
+			TimeNs([&](size_t) { sink = util_unit::Lookup(name, length, unit) ? unit.scale : 0; }), heap,
+			TimeNs([&](size_t) {
+				auto iter = map.find(std::string(name, length));
+				sink = iter != map.end() ? iter->second.scale : 0;
+			}));
+	}
+
+	//单位支持不应拖慢普通算术：同样的数值计算，带单位与不带单位对比
+	printf("  5*1000/1609.344          CalculateExpr %6.1f ns\n",
+		TimeNs([&](size_t) { sink = CalculateExpr("5*1000/1609.344").Value(); }));
+	printf("  5km -> mi                ConvertUnits  %6.1f ns\n",
+		TimeNs([&](size_t) { sink = ConvertUnits("5km", "mi", 7).Value(); }));
+	printf("  60 km/h -> m/s           ConvertUnits  %6.1f ns\n",
+		TimeNs([&](size_t) { sink = ConvertUnits("60 km/h", "m/s", 11).Value(); }));
+	printf("  100 F -> C               ConvertUnits  %6.1f ns\n",
+		TimeNs([&](size_t) { sink = ConvertUnits("100 F", "C", 9).Value(); }));
+}
+
+struct Bench
+{
+	const char* name;
+	void (*run)();
+	const char* description;
+};
+
+static const Bench kBenches[] = {
+	{ "cache", BenchCache, "persistent result cache: open time, lookups, hit rate" },
+	{ "modmath", BenchModMath, "PowMod (Montgomery / 128-bit) vs naive square-and-multiply" },
+	{ "prime", BenchPrime, "Factor (trial division + Pollard-rho) vs plain trial division" },
+	{ "stream", BenchStream, "streaming CalculateExpr vs MakeRpn + CalculateRpn on multi-MB input" },
+	{ "parallel", BenchParallel, "split evaluation on the thread pool vs sequential, same result" },
+	{ "errors", BenchErrors, "malformed vs valid input: error results instead of exceptions" },
+	{ "decimal", BenchDecimal, "decimal floating point vs double: operators, formatting, whole expressions" },
+	{ "big", BenchBig, "arbitrary precision at 1k/10k/100k digits and time to fail on the work budget" },
+	{ "solve", BenchSolve, "root finding: polynomial and transcendental equations, batched vs per-point grid scan" },
+	{ "integrate", BenchIntegrate, "adaptive Gauss-Kronrod: accuracy and evaluation count on smooth and singular integrands" },
+	{ "radix", BenchRadix, "radix literals: suffix/prefix regression cases, SWAR vs per-character parsing" },
+	{ "units", BenchUnits, "perfect-hash unit lookup vs unordered_map, allocations, unit conversion vs plain arithmetic" },
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc == 2 && strcmp(argv[1], "-l") == 0)
+	{
+		for (const Bench& bench : kBenches) printf("%-10s %s\n", bench.name, bench.description);
+		return 0;
+	}
+
+	int status = 0;
+	for (const Bench& bench : kBenches)
+	{
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; ++i) selected = selected || strcmp(argv[i], bench.name) == 0;
+		if (!selected) continue;
+
+		printf("%s: %s\n", bench.name, bench.description);
+		bench.run();
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool known = false;
+		for (const Bench& bench : kBenches) known = known || strcmp(argv[i], bench.name) == 0;
+		if (!known)
+		{
+			fprintf(stderr, "unknown benchmark: %s (use -l to list)\n", argv[i]);
+			status = 1;
+		}
+	}
+
+	util_pool::Shutdown();
+	return mismatch ? 1 : status;
+}
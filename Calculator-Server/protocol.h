@@ -0,0 +1,58 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+** 计算服务的请求与回复格式
+** 每帧由4字节大端长度和其后的内容组成，同一连接可以连续发送多个请求，回复按请求顺序返回
+** 请求内容：消息文本（GBK编码，与酷Q消息相同）
+** 回复内容：1字节状态（1表示已处理，0表示不是计算器命令）+ 回复文本
+*/
+namespace protocol {
+	//单帧内容的最大长度
+	constexpr uint32_t kMaxFrame = 64 << 20;
+
+	constexpr char kHandled = 1;
+	constexpr char kIgnored = 0;
+
+	/**
+	** 在缓冲区末尾追加一帧
+	** @param buf 缓冲区
+	** @param data 帧内容
+	** @param len 帧内容长度
+	*/
+	inline void AppendFrame(std::string& buf, const char* data, size_t len)
+	{
+		char header[4] = {
+			static_cast<char>(len >> 24), static_cast<char>(len >> 16),
+			static_cast<char>(len >> 8), static_cast<char>(len)
+		};
+		buf.append(header, 4);
+		buf.append(data, len);
+	}
+
+	/**
+	** 尝试从缓冲区的offset处解析一帧
+	** @param buf 缓冲区
+	** @param offset 解析起点，成功时移动到下一帧起点
+	** @param frame_begin 写入帧内容起点
+	** @param frame_len 写入帧内容长度
+	** @return 1表示解析到完整的帧，0表示数据不足，-1表示帧长度超过上限
+	*/
+	inline int ParseFrame(const std::string& buf, size_t& offset, size_t& frame_begin, size_t& frame_len)
+	{
+		if (buf.length() - offset < 4) return 0;
+
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(buf.data() + offset);
+		uint32_t len = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+			| (static_cast<uint32_t>(p[2]) << 8) | p[3];
+		if (len > kMaxFrame) return -1;
+		if (buf.length() - offset - 4 < len) return 0;
+
+		frame_begin = offset + 4;
+		frame_len = len;
+		offset += 4 + len;
+		return 1;
+	}
+};
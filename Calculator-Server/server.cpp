@@ -0,0 +1,512 @@
+/*
+* 计算器独立服务
+* 通过Unix域套接字提供与酷Q插件相同的Dispose处理，协议见protocol.h
+* 主线程运行epoll事件循环负责收发，计算交给工作线程，同一连接上的请求可以流水线发送
+*/
+
+#include "protocol.h"
+#include "../Calculator-CoolQ/dispose.h"
+#include "../Calculator-CoolQ/util/config.h"
+#include "../Calculator-CoolQ/util/prime.h"
+#include "../Calculator-CoolQ/util/result_cache.h"
+#include "../Calculator-CoolQ/util/thread_pool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//单个连接上同时处理中的请求数上限，超过后暂停读取该连接
+static const size_t kMaxPipeline = 1024;
+static const size_t kReadChunk = 64 << 10;
+
+struct Job
+{
+	uint64_t conn_id;
+	uint64_t seq;
+	std::string msg;
+};
+
+struct Completion
+{
+	uint64_t conn_id;
+	uint64_t seq;
+	std::string reply;
+};
+
+struct Connection
+{
+	int fd;
+	std::string in;
+	size_t in_offset = 0;
+	std::string out;
+	size_t out_offset = 0;
+	//下一个请求的序号与下一个应当回复的序号
+	uint64_t next_seq = 0;
+	uint64_t next_reply = 0;
+	//已完成但还没轮到回复的结果
+	std::map<uint64_t, std::string> ready;
+	size_t inflight = 0;
+	//对端已关闭写端，回复发送完毕后关闭连接
+	bool closing = false;
+	//对端已挂断；EPOLLHUP无法屏蔽，没有待发送的数据时把fd移出epoll，等处理中的请求完成
+	bool hangup = false;
+	bool watched = true;
+	uint32_t events = 0;
+};
+
+static std::mutex job_mutex;
+static std::condition_variable job_cv;
+static std::deque<Job> jobs;
+static bool stopping = false;
+
+static std::mutex completion_mutex;
+static std::vector<Completion> completions;
+static int completion_fd = -1;
+
+static void WorkerMain()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(job_mutex);
+			job_cv.wait(lock, [] { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		std::string result;
+		bool handled = Dispose(1, 0, 0, std::move(job.msg), result);
+
+		Completion completion;
+		completion.conn_id = job.conn_id;
+		completion.seq = job.seq;
+		completion.reply.push_back(handled ? protocol::kHandled : protocol::kIgnored);
+		completion.reply += result;
+
+		bool wake;
+		{
+			std::lock_guard<std::mutex> lock(completion_mutex);
+			wake = completions.empty();
+			completions.push_back(std::move(completion));
+		}
+
+		//队列由空变为非空时才需要唤醒事件循环
+		if (wake)
+		{
+			uint64_t one = 1;
+			if (write(completion_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+				perror("write eventfd");
+		}
+	}
+}
+
+class Server
+{
+public:
+	Server(int epoll_fd, int listen_fd) : epoll_fd_(epoll_fd), listen_fd_(listen_fd) {}
+
+	void Accept()
+	{
+		while (true)
+		{
+			int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0)
+			{
+				if (errno != EAGAIN && errno != EINTR) perror("accept4");
+				return;
+			}
+
+			uint64_t id = next_id_++;
+			Connection& conn = connections_[id];
+			conn.fd = fd;
+			conn.events = EPOLLIN;
+
+			epoll_event ev = {};
+			ev.events = conn.events;
+			ev.data.u64 = id;
+			epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+		}
+	}
+
+	void HandleEvent(uint64_t id, uint32_t events)
+	{
+		auto iter = connections_.find(id);
+		if (iter == connections_.end()) return;
+		Connection& conn = iter->second;
+
+		if (events & EPOLLERR)
+		{
+			Close(id);
+			return;
+		}
+
+		//挂断时接收缓冲区中可能还有流水线发来的请求，照常读取并回复，回复发完或写入失败时才关闭
+		if ((events & (EPOLLIN | EPOLLHUP)) && !Read(conn))
+		{
+			Close(id);
+			return;
+		}
+		if (events & EPOLLHUP)
+		{
+			conn.closing = true;
+			conn.hangup = true;
+		}
+
+		if (!Write(conn))
+		{
+			Close(id);
+			return;
+		}
+
+		Update(id, conn);
+	}
+
+	void DrainCompletions()
+	{
+		uint64_t counter;
+		if (read(completion_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+			perror("read eventfd");
+
+		std::vector<Completion> batch;
+		{
+			std::lock_guard<std::mutex> lock(completion_mutex);
+			batch.swap(completions);
+		}
+
+		//先把结果放回各自的连接，再统一按序号刷新回复
+		std::vector<uint64_t> touched;
+		for (Completion& completion : batch)
+		{
+			auto iter = connections_.find(completion.conn_id);
+			if (iter == connections_.end()) continue;
+
+			Connection& conn = iter->second;
+			conn.ready[completion.seq] = std::move(completion.reply);
+			--conn.inflight;
+			touched.push_back(completion.conn_id);
+		}
+
+		for (uint64_t id : touched)
+		{
+			auto iter = connections_.find(id);
+			if (iter == connections_.end()) continue;
+
+			Connection& conn = iter->second;
+			FlushReady(conn);
+			//暂停读取期间缓存的请求在这里继续分发
+			Dispatch(id, conn);
+			if (!Write(conn))
+			{
+				Close(id);
+				continue;
+			}
+			Update(id, conn);
+		}
+	}
+
+	void CloseAll()
+	{
+		while (!connections_.empty()) Close(connections_.begin()->first);
+	}
+
+private:
+	bool Read(Connection& conn)
+	{
+		while (true)
+		{
+			size_t old_size = conn.in.size();
+			conn.in.resize(old_size + kReadChunk);
+			ssize_t n = read(conn.fd, &conn.in[old_size], kReadChunk);
+			conn.in.resize(old_size + (n > 0 ? n : 0));
+
+			if (n > 0) continue;
+			if (n == 0)
+			{
+				conn.closing = true;
+				break;
+			}
+			if (errno == EAGAIN) break;
+			if (errno != EINTR) return false;
+		}
+		return true;
+	}
+
+	/**
+	** 从输入缓冲区中解析完整的请求并交给工作线程，处理中的请求数达到上限时停止
+	*/
+	void Dispatch(uint64_t id, Connection& conn)
+	{
+		std::vector<Job> parsed;
+		while (conn.inflight < kMaxPipeline)
+		{
+			size_t begin, len;
+			int state = protocol::ParseFrame(conn.in, conn.in_offset, begin, len);
+			if (state == 0) break;
+			if (state < 0)
+			{
+				//帧长度非法，无法继续解析，等回复发送完后关闭
+				conn.closing = true;
+				conn.in.clear();
+				conn.in_offset = 0;
+				break;
+			}
+
+			parsed.push_back(Job{ id, conn.next_seq++, conn.in.substr(begin, len) });
+			++conn.inflight;
+		}
+
+		//已解析的部分超过一半时整理缓冲区
+		if (conn.in_offset > 0 && conn.in_offset * 2 >= conn.in.size())
+		{
+			conn.in.erase(0, conn.in_offset);
+			conn.in_offset = 0;
+		}
+
+		if (parsed.empty()) return;
+		{
+			std::lock_guard<std::mutex> lock(job_mutex);
+			for (Job& job : parsed) jobs.push_back(std::move(job));
+		}
+		job_cv.notify_all();
+	}
+
+	/**
+	** 将已完成且轮到的回复按序号写入输出缓冲区
+	*/
+	void FlushReady(Connection& conn)
+	{
+		while (!conn.ready.empty() && conn.ready.begin()->first == conn.next_reply)
+		{
+			const std::string& reply = conn.ready.begin()->second;
+			protocol::AppendFrame(conn.out, reply.data(), reply.size());
+			conn.ready.erase(conn.ready.begin());
+			++conn.next_reply;
+		}
+	}
+
+	bool Write(Connection& conn)
+	{
+		while (conn.out_offset < conn.out.size())
+		{
+			ssize_t n = write(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset);
+			if (n > 0)
+			{
+				conn.out_offset += n;
+				continue;
+			}
+			if (n < 0 && errno == EAGAIN) break;
+			if (n < 0 && errno == EINTR) continue;
+			return false;
+		}
+
+		if (conn.out_offset == conn.out.size())
+		{
+			conn.out.clear();
+			conn.out_offset = 0;
+		}
+		return true;
+	}
+
+	/**
+	** 根据连接状态更新epoll关注的事件，对端关闭且回复发完时关闭连接
+	*/
+	void Update(uint64_t id, Connection& conn)
+	{
+		Dispatch(id, conn);
+		FlushReady(conn);
+
+		bool pending_out = conn.out_offset < conn.out.size();
+		if (conn.closing && conn.inflight == 0 && !pending_out)
+		{
+			Close(id);
+			return;
+		}
+
+		uint32_t events = 0;
+		if (!conn.closing && conn.inflight < kMaxPipeline) events |= EPOLLIN;
+		if (pending_out) events |= EPOLLOUT;
+
+		//挂断后仍留在epoll中会不停收到EPOLLHUP，只在有数据要发送时关注
+		bool watch = !conn.hangup || pending_out;
+		if (watch != conn.watched || (watch && events != conn.events))
+		{
+			epoll_event ev = {};
+			ev.events = events;
+			ev.data.u64 = id;
+			epoll_ctl(epoll_fd_, !watch ? EPOLL_CTL_DEL : conn.watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn.fd, &ev);
+			conn.watched = watch;
+			conn.events = events;
+		}
+	}
+
+	void Close(uint64_t id)
+	{
+		auto iter = connections_.find(id);
+		if (iter == connections_.end()) return;
+
+		if (iter->second.watched) epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, iter->second.fd, nullptr);
+		close(iter->second.fd);
+		connections_.erase(iter);
+	}
+
+	int epoll_fd_;
+	int listen_fd_;
+	//0、1、2留给监听套接字、eventfd和signalfd
+	uint64_t next_id_ = 3;
+	std::unordered_map<uint64_t, Connection> connections_;
+};
+
+static const uint64_t kListenId = 0;
+static const uint64_t kCompletionId = 1;
+static const uint64_t kSignalId = 2;
+
+static void Usage(const char* name)
+{
+	fprintf(stderr,
+		"usage: %s [-s socket_path] [-t threads] [-d data_dir]\n"
+		"  -s  Unix domain socket path (default /tmp/calculator.sock)\n"
+		"  -t  number of worker threads (default: number of cores)\n"
+		"  -d  directory for result.cache and config.ini (default: no cache, built-in config)\n",
+		name);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string socket_path = "/tmp/calculator.sock";
+	std::string data_dir;
+	unsigned threads = std::thread::hardware_concurrency();
+	if (threads == 0) threads = 1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:t:d:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			socket_path = optarg;
+			break;
+		case 't':
+			threads = static_cast<unsigned>(atoi(optarg));
+			break;
+		case 'd':
+			data_dir = optarg;
+			break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (threads == 0 || socket_path.size() >= sizeof(sockaddr_un::sun_path))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	//与插件的__eventStartup相同的初始化
+	if (!data_dir.empty())
+	{
+		util_cache::Init(data_dir + "/result.cache");
+		util_config::Init(data_dir + "/config.ini");
+	}
+	util_prime::Init();
+
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path.c_str());
+	unlink(socket_path.c_str());
+	if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0)
+	{
+		perror(socket_path.c_str());
+		return 1;
+	}
+
+	completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = kListenId;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+	ev.data.u64 = kCompletionId;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, completion_fd, &ev);
+	ev.data.u64 = kSignalId;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; ++i) workers.emplace_back(WorkerMain);
+
+	fprintf(stderr, "listening on %s with %u worker threads\n", socket_path.c_str(), threads);
+
+	Server server(epoll_fd, listen_fd);
+	std::vector<epoll_event> events(256);
+	bool running = true;
+	while (running)
+	{
+		int n = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+		if (n < 0 && errno != EINTR)
+		{
+			perror("epoll_wait");
+			break;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			uint64_t id = events[i].data.u64;
+			if (id == kListenId)
+				server.Accept();
+			else if (id == kCompletionId)
+				server.DrainCompletions();
+			else if (id == kSignalId)
+				running = false;
+			else
+				server.HandleEvent(id, events[i].events);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	job_cv.notify_all();
+	for (std::thread& worker : workers) worker.join();
+
+	server.CloseAll();
+	close(listen_fd);
+	unlink(socket_path.c_str());
+
+	//与插件的__eventExit相同的清理
+	util_cache::Close();
+	util_config::Shutdown();
+	util_pool::Shutdown();
+	return 0;
+}